@@ -0,0 +1,147 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <limits>
+#include <memory>
+#include "ObservationDataset.hpp"
+#include "DatasetWriter.hpp"
+#include "CloudConstructor.hpp"
+#include "RunProfile.hpp"
+
+// In-process entry point of libbarker.
+//
+// Inputs are the MSI_RGR / AC_CLP / AUX_2D views, which may wrap caller-owned
+// arrays (ArrayView::fromMemory with a null owner) without a copy. Results are
+// written straight into caller-provided buffers, tile by tile; the tile
+// callback tells the caller which output pixels are final. The input arrays
+// and the output buffers must outlive the processor.
+class BarkerProcessor {
+public:
+    struct Options {
+        size_t k_candidates = 100;
+        size_t max_idx_distance = 2000;
+        size_t aux_offset = 100;          // AUX index - AC_CLP index at the same point
+        double delta_mu0 = 30.0;
+        double delta_phi0 = 30.0;
+        // MSI rows [i_min, i_max] are processed (i_max clamped to the last row)
+        size_t i_min = 0;
+        size_t i_max = std::numeric_limits<size_t>::max();
+        // Profile and surface variable names to produce (empty: all)
+        std::vector<std::string> variables;
+        CloudConstructor::SearchOptions search;
+        bool autotune = false;            // Replaces search by the autotuned options
+        std::string autotune_cache;       // Empty: no cache
+        size_t autotune_max_threads = 0;  // Largest thread count tried by the autotuner (0: all cores)
+        size_t multires_block = 0;        // > 0: coarse-to-fine donor search
+        CloudConstructor::MultiresolutionOptions multires;
+    };
+
+    // Caller-owned outputs; a null buffer is not produced (mapped_indices and
+    // profiles then go to internal buffers). Pixels without a donor hold
+    // SIZE_MAX in mapped_indices and NaN in profiles and surface.
+    // Every element is written by run(), so the buffers need no initialisation.
+    // They should not be pre-touched (no std::vector<double>(n), memset or fill):
+    // each tile's pages are then first touched, and so placed on the NUMA node,
+    // by the worker filling it. FirstTouchVector or new double[n] leave them untouched.
+    struct Buffers {
+        size_t* mapped_indices = nullptr; // [H_out][W_out]
+        double* profiles = nullptr;       // [profile variables][H_out][W_out][K]
+        double* surface = nullptr;        // [surface variables][H_out][W_out], flags as 0 / 1
+    };
+
+    using Tile = CloudConstructor::Tile;
+    using TileCallback = CloudConstructor::TileCallback;
+    using ProfileLoader = CloudConstructor::ProfileLoader;
+
+    // acclp receives the log spectra of the donor search; aux2d is only read
+    BarkerProcessor(const MSI_RGR_Data& msi, AC_CLP_Data& acclp, const AUX__2D_Data& aux2d,
+                    const Options& options);
+
+    // All variable names known to the library, in output order
+    static const std::vector<std::string>& profileVariableNames();
+    static const std::vector<std::string>& surfaceVariableNames();
+
+    // Indices of the profile / surface variables among those names, in library order
+    // (empty names: all); throws std::invalid_argument for an unknown name
+    static void selectVariables(const std::vector<std::string>& names,
+                                std::vector<size_t>& profile_ids, std::vector<size_t>& surface_ids);
+
+    // Output file of a run: an HDF5 file or a Zarr store ("hdf5" / "zarr") written
+    // by `threads` threads. In an MPI build the HDF5 file is shared by all ranks,
+    // each holding rows [row_offset, row_offset + H_out) of total_rows.
+    static std::unique_ptr<DatasetWriter> openOutput(const std::string& path, const std::string& format,
+                                                     size_t threads = 1, size_t row_offset = 0,
+                                                     size_t total_rows = 0);
+
+    // Surface planes [names][H_out][W_out] as written by write(): flags as int, -1 without donor
+    static void writeSurface(DatasetWriter& writer, const std::vector<std::string>& names, const double* surface,
+                             size_t H_out, size_t W_out);
+
+    // Selected variables, in buffer order
+    const std::vector<std::string>& profileVariables() const { return profile_variables_; }
+    const std::vector<std::string>& surfaceVariables() const { return surface_variables_; }
+
+    size_t outputHeight() const { return constructor_.outputHeight(); }
+    size_t outputWidth() const { return constructor_.outputWidth(); }
+    size_t firstRow() const { return i_min_; }
+    size_t verticalLevels() const { return constructor_.verticalLevels(); }
+    // Search configuration in use, autotuned or from the options
+    const CloudConstructor::SearchOptions& searchOptions() const { return constructor_.searchOptions(); }
+
+    // Buffer sizes in elements
+    size_t mappedIndicesSize() const { return outputHeight() * outputWidth(); }
+    size_t profilesSize() const { return profile_variables_.size() * mappedIndicesSize() * verticalLevels(); }
+    size_t surfaceSize() const { return surface_variables_.size() * mappedIndicesSize(); }
+
+    // Called once the donors are known, for inputs whose profiles are read lazily
+    void setProfileLoader(ProfileLoader loader) { constructor_.setProfileLoader(std::move(loader)); }
+
+    // Donor search and mapping into buffers; on_tile runs on the worker threads
+    void run(const Buffers& buffers, TileCallback on_tile = nullptr);
+
+    // Donor indices only, [criteria][H_out][W_out] into mapped_indices
+    void runSweep(const std::vector<DonorSelector::Criteria>& criteria, size_t* mapped_indices);
+
+    // Output datasets of the last run(): mapped_indices, the selected profiles
+    // [H_out][W_out][K] and surface fields (when a surface buffer was given),
+    // latitude and longitude. After runSweep(): mapped_indices
+    // [criteria][H_out][W_out], sweep_parameters (k_candidates, max_idx_distance,
+    // delta_mu0, delta_phi0 per row), latitude and longitude.
+    void write(DatasetWriter& writer);
+
+    // Results of the last run, wherever they were written
+    const size_t* mappedIndices() const { return constructor_.mappedIndices(); }
+    const double* profiles() const { return constructor_.mappedData(); }
+
+    // Statistics of the last multiresolution run
+    const CloudConstructor::MultiresolutionStats& multiresolutionStats() const { return multires_stats_; }
+
+    // Configuration chosen for this run (options, search engine, timings)
+    RunProfile& profile() { return profile_; }
+    const RunProfile& profile() const { return profile_; }
+
+private:
+    static size_t lastRow(const MSI_RGR_Data& msi, const Options& options);
+    void fillSurface(const Tile& tile, double* surface) const;
+    void recordPlacement(const NumaTopology::Counters& before);
+
+    void writeGeolocation(DatasetWriter& writer) const;
+
+    // What the last run produced, for write()
+    enum class LastRun { NONE, CONSTRUCT, SWEEP };
+
+    const MSI_RGR_Data& msi_;
+    const AUX__2D_Data& aux2d_;
+    Options options_;
+    size_t i_min_;
+    std::vector<std::string> profile_variables_;
+    std::vector<std::string> surface_variables_;
+    std::vector<size_t> surface_ids_;     // Indices into surfaceVariableNames
+    CloudConstructor constructor_;
+    CloudConstructor::MultiresolutionStats multires_stats_;
+    RunProfile profile_;
+    LastRun last_run_ = LastRun::NONE;
+    const double* surface_ = nullptr;     // Surface buffer of the last run
+    std::vector<DonorSelector::Criteria> sweep_criteria_;
+    const size_t* sweep_indices_ = nullptr;
+};
@@ -0,0 +1,54 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "DatasetWriter.hpp"
+#include "IncrementalConstructor.hpp"
+
+// Near-real-time entry point of libbarker: watches a directory for along-track
+// segment files and writes every batch of finished rows as it is emitted.
+//
+// Segments are recognised by product name (MSI_RGR, AC__CLP / AC_CLP, AUX) and
+// taken in file name order; a file named END closes the stream.
+// A segment is only read once it is complete: names starting with '.' or ending
+// in .tmp / .part (a producer writing before renaming) are skipped, and a file is
+// taken once its size and modification time are unchanged over two polls. A
+// segment that still fails to read is retried on the next polls. END is honoured
+// once every segment in the directory has been taken.
+class SegmentWatcher {
+public:
+    struct Options {
+        size_t k_candidates = 100;
+        size_t max_idx_distance = 2000;
+        size_t aux_offset = 100;          // AUX index - AC_CLP index at the same point
+        double delta_mu0 = 30.0;
+        double delta_phi0 = 30.0;
+        // Profile and surface variable names to produce (empty: all)
+        std::vector<std::string> variables;
+        std::string format = "hdf5";      // Output of each batch: "hdf5" or "zarr"
+        double poll_seconds = 1.0;
+        size_t max_read_attempts = 10;    // Reads of a segment before giving up
+    };
+
+    // Batches are written to output_dir/rows_<first>_<last>.h5 (.zarr)
+    SegmentWatcher(const std::string& segment_dir, const std::string& output_dir, const Options& options);
+
+    // Polls until END and the last rows are written
+    void run();
+
+    // One batch of emitted rows with the datasets of the batch run (BarkerProcessor::write);
+    // the names are the selected variables, in the order of the emitted planes
+    static void writeEmittedRows(DatasetWriter& writer, const IncrementalConstructor::EmittedRows& rows,
+                                 const std::vector<std::string>& profile_variables,
+                                 const std::vector<std::string>& surface_variables);
+
+private:
+    void writeBatch(const IncrementalConstructor::EmittedRows& rows) const;
+
+    std::string segment_dir_;
+    std::string output_dir_;
+    Options options_;
+    std::vector<size_t> profile_ids_;
+    std::vector<size_t> surface_ids_;
+    std::vector<std::string> profile_variables_;
+    std::vector<std::string> surface_variables_;
+};
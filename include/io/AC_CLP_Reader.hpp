@@ -1,9 +1,18 @@
 #pragma once
 #include <memory>
 #include <string>
+#include <vector>
 #include "ObservationDataset.hpp"
 
 class AC_CLP_Reader {
 public:
     static std::unique_ptr<AC_CLP_Data> read(const std::string& filepath);
+
+    // Geometry only; the profile fields stay empty until readProfiles
+    static std::unique_ptr<AC_CLP_Data> readGeometry(const std::string& filepath);
+
+    // Gathers the sorted, unique AC_CLP rows of the named profile variables
+    // (CloudConstructor::profileVariableNames); other variables are not read
+    static void readProfiles(const std::string& filepath, const std::vector<size_t>& rows,
+                             const std::vector<std::string>& variables, AC_CLP_Data& acclp_data);
 };
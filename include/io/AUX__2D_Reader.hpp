@@ -1,9 +1,18 @@
 #pragma once
 #include <memory>
 #include <string>
+#include <vector>
 #include "ObservationDataset.hpp"
 
 class AUX__2D_Reader {
 public:
     static std::unique_ptr<AUX__2D_Data> read(const std::string& filepath);
+
+    // Geometry only; profiles and surface fields stay empty until readProfiles
+    static std::unique_ptr<AUX__2D_Data> readGeometry(const std::string& filepath);
+
+    // Gathers the sorted, unique AUX rows of the named profile and surface
+    // variables; other variables are not read
+    static void readProfiles(const std::string& filepath, const std::vector<size_t>& rows,
+                             const std::vector<std::string>& variables, AUX__2D_Data& aux2d_data);
 };
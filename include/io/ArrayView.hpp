@@ -0,0 +1,93 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <stdexcept>
+
+// Read-only, row-major N-d array.
+//
+// The elements either live in a buffer owned by the view or in memory kept
+// alive by a shared owner (e.g. a read-only file mapping). Copies and row
+// slices share the same storage. Indexing follows the nested vectors it
+// replaces: view[i][j] for 2-D, view[i] for 1-D, view(b, i, j) for any rank.
+template <typename T, size_t Rank>
+class ArrayView {
+public:
+    using value_type = T;
+    using Shape = std::array<size_t, Rank>;
+    static constexpr size_t rank = Rank;
+
+    ArrayView() : shape_{} {}
+
+    // View owning its buffer
+    static ArrayView fromVector(std::vector<T> values, const Shape& shape) {
+        auto buffer = std::make_shared<std::vector<T>>(std::move(values));
+        ArrayView view(buffer->data(), shape, buffer);
+        if (buffer->size() != view.numElements()) {
+            throw std::invalid_argument("ArrayView: buffer size does not match shape");
+        }
+        view.mapped_ = false;
+        return view;
+    }
+
+    // View on memory kept alive by owner (nullptr: caller-owned memory)
+    static ArrayView fromMemory(const T* data, const Shape& shape, std::shared_ptr<const void> owner) {
+        return ArrayView(data, shape, std::move(owner));
+    }
+
+    const T* data() const { return data_; }
+    const Shape& shape() const { return shape_; }
+    size_t extent(size_t dim) const { return shape_[dim]; }
+    size_t size() const { return shape_[0]; }  // Extent of the first dimension
+    bool empty() const { return numElements() == 0; }
+    // True when the elements are not held in a buffer of this view (mapped or borrowed)
+    bool isMapped() const { return mapped_; }
+
+    size_t numElements() const {
+        size_t n = 1;
+        for (size_t d : shape_) n *= d;
+        return n;
+    }
+
+    // Element (1-D) or row pointer (2-D)
+    decltype(auto) operator[](size_t i) const {
+        static_assert(Rank <= 2, "use operator() for rank > 2");
+        if constexpr (Rank == 1) {
+            return data_[i];
+        } else {
+            return data_ + i * shape_[1];
+        }
+    }
+
+    template <typename... Index>
+    const T& operator()(Index... index) const {
+        static_assert(sizeof...(Index) == Rank, "wrong number of indices");
+        size_t offset = 0;
+        size_t d = 0;
+        ((offset = offset * shape_[d++] + static_cast<size_t>(index)), ...);
+        return data_[offset];
+    }
+
+    // Rows [begin, end) of the first dimension, sharing storage
+    ArrayView sliceRows(size_t begin, size_t end) const {
+        Shape shape = shape_;
+        shape[0] = end - begin;
+        ArrayView view(data_ + begin * (numElements() / (shape_[0] ? shape_[0] : 1)), shape, owner_);
+        view.mapped_ = mapped_;
+        return view;
+    }
+
+private:
+    ArrayView(const T* data, const Shape& shape, std::shared_ptr<const void> owner)
+        : data_(data), shape_(shape), owner_(std::move(owner)), mapped_(true) {}
+
+    const T* data_ = nullptr;
+    Shape shape_;
+    std::shared_ptr<const void> owner_;
+    bool mapped_ = false;
+};
+
+template <typename T> using ArrayView1D = ArrayView<T, 1>;
+template <typename T> using ArrayView2D = ArrayView<T, 2>;
+template <typename T> using ArrayView3D = ArrayView<T, 3>;
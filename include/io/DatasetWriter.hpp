@@ -0,0 +1,34 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+// Output backend: named N-d datasets of size_t, double or int.
+class DatasetWriter {
+public:
+    // row_dim value of datasets that every rank holds in full (written by rank 0)
+    static constexpr size_t REPLICATED = static_cast<size_t>(-1);
+
+    virtual ~DatasetWriter() = default;
+
+    // shape is the local shape; dimension row_dim is the along-track one
+    // (split across ranks in a shared file, chunked like the rows otherwise)
+    template <typename T, typename Allocator>
+    void writeDataset(const std::string& name, const std::vector<T, Allocator>& data,
+                      const std::vector<size_t>& shape, size_t row_dim = 0) {
+        size_t num_elements = 1;
+        for (size_t d : shape) num_elements *= d;
+        if (data.size() != num_elements) {
+            throw std::invalid_argument("Dataset " + name + ": data size does not match shape");
+        }
+        writeDataset(name, data.data(), shape, row_dim);
+    }
+
+    // Caller-owned buffers holding the product of shape elements
+    virtual void writeDataset(const std::string& name, const size_t* data,
+                              const std::vector<size_t>& shape, size_t row_dim = 0) = 0;
+    virtual void writeDataset(const std::string& name, const double* data,
+                              const std::vector<size_t>& shape, size_t row_dim = 0) = 0;
+    virtual void writeDataset(const std::string& name, const int* data,
+                              const std::vector<size_t>& shape, size_t row_dim = 0) = 0;
+};
@@ -1,27 +1,43 @@
 #pragma once
 #include <string>
 #include <vector>
-#include <H5Cpp.h>
+#include <highfive/H5File.hpp>
+#include "DatasetWriter.hpp"
+#ifdef BARKER_USE_MPI
+#include <mpi.h>
+// HighFive only defines its MPI-IO properties against a parallel HDF5 build
+#ifndef H5_HAVE_PARALLEL
+#error "BARKER_USE_MPI needs parallel HDF5 (H5_HAVE_PARALLEL is not defined)"
+#endif
+#endif
 
-class HDF5_Writer {
+class HDF5_Writer : public DatasetWriter {
 public:
     explicit HDF5_Writer(const std::string& filepath);
 
-    // size_t type dataset
-    void writeDataset(const std::string& name,
-                      const std::vector<size_t>& data,
-                      const std::vector<size_t>& shape);
+#ifdef BARKER_USE_MPI
+    // Shared output file of a multi-process run, created collectively by every rank of comm.
+    // Each rank holds rows [row_offset, row_offset + local rows) of total_rows; datasets are
+    // created collectively and written with collective MPI-IO.
+    HDF5_Writer(const std::string& filepath, MPI_Comm comm, size_t row_offset, size_t total_rows);
+#endif
 
-    // double type dataset
-    void writeDataset(const std::string& name,
-                      const std::vector<double>& data,
-                      const std::vector<size_t>& shape);
-
-    // int type dataset
-    void writeDataset(const std::string& name,
-                      const std::vector<int>& data,
-                      const std::vector<size_t>& shape);
+    using DatasetWriter::writeDataset;
+    void writeDataset(const std::string& name, const size_t* data,
+                      const std::vector<size_t>& shape, size_t row_dim = 0) override;
+    void writeDataset(const std::string& name, const double* data,
+                      const std::vector<size_t>& shape, size_t row_dim = 0) override;
+    void writeDataset(const std::string& name, const int* data,
+                      const std::vector<size_t>& shape, size_t row_dim = 0) override;
 
 private:
-    H5::H5File file_;
+    template <typename T>
+    void write(const std::string& name, const T* data,
+               const std::vector<size_t>& shape, size_t row_dim);
+
+    HighFive::File file_;
+    bool shared_ = false;
+    int rank_ = 0;
+    size_t row_offset_ = 0;
+    size_t total_rows_ = 0;
 };
@@ -0,0 +1,106 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <iostream>
+#include <highfive/H5File.hpp>
+#include "ArrayView.hpp"
+
+// Typed, read-only access to HDF5 datasets.
+//
+// Datasets stored contiguous, unfiltered and in the native representation of
+// T are memory-mapped straight from the file, so only the pages actually
+// touched are read. Chunked / compressed datasets and datasets needing a type
+// conversion fall back to a single buffered read.
+class MappedDataset {
+public:
+    template <typename T, size_t Rank>
+    static ArrayView<T, Rank> read(const HighFive::File& file, const std::string& name) {
+        HighFive::DataSet dataset = file.getDataSet(name);
+        std::vector<size_t> dims = dataset.getDimensions();
+        if (dims.size() != Rank) {
+            throw std::runtime_error("Dataset " + name + " has rank " + std::to_string(dims.size()) +
+                                     ", expected " + std::to_string(Rank));
+        }
+        typename ArrayView<T, Rank>::Shape shape;
+        size_t num_elements = 1;
+        for (size_t d = 0; d < Rank; ++d) {
+            shape[d] = dims[d];
+            num_elements *= dims[d];
+        }
+
+        uint64_t offset = 0;
+        if (enabled() && num_elements > 0 &&
+            contiguousOffset(dataset, HighFive::create_datatype<T>(), sizeof(T), alignof(T), offset)) {
+            const void* data = nullptr;
+            auto mapping = mapRegion(file.getName(), offset, num_elements * sizeof(T), data);
+            if (mapping) {
+                std::cout << "[MappedDataset] " << name << ": mapped (" << num_elements * sizeof(T) << " bytes)" << std::endl;
+                return ArrayView<T, Rank>::fromMemory(static_cast<const T*>(data), shape, std::move(mapping));
+            }
+        }
+
+        std::vector<T> values(num_elements);
+        if (num_elements > 0) {
+            dataset.read_raw(values.data());
+        }
+        std::cout << "[MappedDataset] " << name << ": buffered (" << num_elements * sizeof(T) << " bytes)" << std::endl;
+        return ArrayView<T, Rank>::fromVector(std::move(values), shape);
+    }
+
+    // Rows of the first dimension only, gathered with one hyperslab selection.
+    // rows must be sorted and unique; row r of the result is dataset row rows[r].
+    template <typename T, size_t Rank>
+    static ArrayView<T, Rank> readRows(const HighFive::File& file, const std::string& name,
+                                       const std::vector<size_t>& rows) {
+        HighFive::DataSet dataset = file.getDataSet(name);
+        std::vector<size_t> dims = dataset.getDimensions();
+        if (dims.size() != Rank) {
+            throw std::runtime_error("Dataset " + name + " has rank " + std::to_string(dims.size()) +
+                                     ", expected " + std::to_string(Rank));
+        }
+        typename ArrayView<T, Rank>::Shape shape;
+        shape[0] = rows.size();
+        size_t row_elements = 1;
+        for (size_t d = 1; d < Rank; ++d) {
+            shape[d] = dims[d];
+            row_elements *= dims[d];
+        }
+
+        std::vector<T> values(rows.size() * row_elements);
+        if (!values.empty()) {
+            // Consecutive rows are merged into one block
+            std::vector<size_t> count(dims.begin(), dims.end());
+            std::vector<size_t> offset(Rank, 0);
+            HighFive::HyperSlab slab;
+            for (size_t r = 0; r < rows.size();) {
+                if (rows[r] >= dims[0] || (r > 0 && rows[r] <= rows[r - 1])) {
+                    throw std::out_of_range("Dataset " + name + ": rows must be sorted, unique and in range");
+                }
+                size_t end = r + 1;
+                while (end < rows.size() && rows[end] == rows[end - 1] + 1) ++end;
+                offset[0] = rows[r];
+                count[0] = end - r;
+                slab |= HighFive::RegularHyperSlab(offset, count);
+                r = end;
+            }
+            dataset.select(slab, HighFive::DataSpace({values.size()})).read_raw(values.data());
+        }
+        std::cout << "[MappedDataset] " << name << ": gathered " << rows.size() << " / " << dims[0]
+                  << " rows (" << values.size() * sizeof(T) << " bytes)" << std::endl;
+        return ArrayView<T, Rank>::fromVector(std::move(values), shape);
+    }
+
+    // Memory mapping is switched off by the environment variable BARKER_NO_MMAP,
+    // read once at the first call
+    static bool enabled();
+
+private:
+    // File offset of a contiguous, allocated, unfiltered dataset whose file type equals mem_type
+    static bool contiguousOffset(const HighFive::DataSet& dataset, const HighFive::DataType& mem_type,
+                                 size_t element_size, size_t alignment, uint64_t& offset);
+    // Read-only mapping of [offset, offset + length) of a file; nullptr on failure
+    static std::shared_ptr<const void> mapRegion(const std::string& filepath, uint64_t offset,
+                                                 size_t length, const void*& data);
+};
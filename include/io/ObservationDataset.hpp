@@ -1,22 +1,44 @@
 #pragma once
 #include <vector>
 #include <array>
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+#include "ArrayView.hpp"
+
+// Row of a gathered profile field holding the given along-track index.
+// rows is empty when every row is loaded, otherwise the sorted indices gathered.
+inline size_t gatheredRow(const std::vector<size_t>& rows, size_t index) {
+    if (rows.empty()) {
+        return index;
+    }
+    auto it = std::lower_bound(rows.begin(), rows.end(), index);
+    if (it == rows.end() || *it != index) {
+        throw std::out_of_range("Profile row " + std::to_string(index) + " was not gathered");
+    }
+    return static_cast<size_t>(it - rows.begin());
+}
 
 struct MSI_RGR_Data {
-    using Vec2D = std::vector<std::vector<double>>;
-    using Vec2DInt = std::vector<std::vector<int>>;
-    using Vec3D = std::vector<std::vector<std::vector<double>>>;
-    Vec3D radiance;
+    using Vec2D = ArrayView2D<double>;
+    using Vec2DInt = ArrayView2D<int>;
+    using Vec3D = ArrayView3D<double>;
+    Vec3D radiance;  // [B][H][W], band-major as stored in pixel_values
     Vec2D longitude;
     Vec2D latitude;
     Vec2D mu0;
     Vec2D phi0;
     Vec2DInt surface_type;
+
+    size_t height() const { return longitude.extent(0); }
+    size_t width() const { return longitude.extent(1); }
+    size_t bands() const { return radiance.extent(0); }
+    double radianceAt(size_t i, size_t j, size_t b) const { return radiance(b, i, j); }
 };
 
 struct AC_CLP_Data {
-    using Vec2D = std::vector<std::vector<double>>;
-    using Vec2DInt = std::vector<std::vector<int>>;
+    using Vec2D = ArrayView2D<double>;
+    using Vec2DInt = ArrayView2D<int>;
     using Point = std::array<double, 2>;
     using Spectrum = std::array<double, 7>;
 
@@ -29,15 +51,20 @@ struct AC_CLP_Data {
     Vec2DInt radar_lidar_flag;
     Vec2D height;
 
-    std::vector<double> longitude;
-    std::vector<double> latitude;
+    ArrayView1D<double> longitude;
+    ArrayView1D<double> latitude;
+
+    std::vector<Spectrum> radiance;  // Log spectrum of the nearest MSI pixel
 
-    std::vector<Spectrum> radiance;
+    size_t vertical_levels = 0;       // K, known before the profiles are read
+    std::vector<size_t> profile_rows; // Gathered AC_CLP indices (empty: all rows loaded)
+
+    size_t profileRow(size_t ac_idx) const { return gatheredRow(profile_rows, ac_idx); }
 };
 
 
 struct AUX__2D_Data {
-    using Vec2D = std::vector<std::vector<double>>;
+    using Vec2D = ArrayView2D<double>;
 
     Vec2D ozoneMassMixingRatio;
     Vec2D pressure;
@@ -45,11 +72,15 @@ struct AUX__2D_Data {
     Vec2D temperature;
     Vec2D height;
 
-    std::vector<double> surfacePressure;
-    std::vector<double> totalColumnOzone;
-    std::vector<double> totalColumnWaterVapor;
-    std::vector<int> day_night_flag;  // 1: day, 0: night
-    std::vector<int> land_water_flag; // 1: land, 0: water
-    std::vector<double> longitude;
-    std::vector<double> latitude;
+    ArrayView1D<double> surfacePressure;
+    ArrayView1D<double> totalColumnOzone;
+    ArrayView1D<double> totalColumnWaterVapor;
+    ArrayView1D<int> day_night_flag;  // 1: day, 0: night
+    ArrayView1D<int> land_water_flag; // 1: land, 0: water
+    ArrayView1D<double> longitude;
+    ArrayView1D<double> latitude;
+
+    std::vector<size_t> profile_rows; // Gathered AUX indices (empty: all rows loaded)
+
+    size_t profileRow(size_t aux_idx) const { return gatheredRow(profile_rows, aux_idx); }
 };
@@ -0,0 +1,29 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <utility>
+#include <sstream>
+
+// Key / value record of one run (configuration choices, timings, counters),
+// written as "key = value" lines next to the output file.
+class RunProfile {
+public:
+    // Replaces an existing key, keeps insertion order otherwise
+    void set(const std::string& key, const std::string& value);
+    void set(const std::string& key, const char* value) { set(key, std::string(value)); }
+    void set(const std::string& key, bool value) { set(key, std::string(value ? "true" : "false")); }
+
+    template <typename T>
+    void set(const std::string& key, const T& value) {
+        std::ostringstream text;
+        text << value;
+        set(key, text.str());
+    }
+
+    const std::vector<std::pair<std::string, std::string>>& entries() const { return entries_; }
+
+    void write(const std::string& filepath) const;
+
+private:
+    std::vector<std::pair<std::string, std::string>> entries_;
+};
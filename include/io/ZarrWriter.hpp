@@ -0,0 +1,40 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "DatasetWriter.hpp"
+
+// Zarr v2 directory store: one group, one array directory per dataset.
+//
+// Each array is split into chunks of chunk_rows x chunk_cols along the row
+// dimension and the one after it (dimensions before row_dim are chunked by 1,
+// later ones are kept whole). Chunks are zlib-compressed independently, written
+// as "<array>/<i>.<j>..." by worker threads and described by "<array>/.zarray".
+// Edge chunks are padded with the fill value, as Zarr requires.
+class Zarr_Writer : public DatasetWriter {
+public:
+    // Creates the store; an existing Zarr store at path is replaced
+    explicit Zarr_Writer(const std::string& path, size_t threads = 1, int compression_level = 1,
+                         size_t chunk_rows = 32, size_t chunk_cols = 32);
+
+    using DatasetWriter::writeDataset;
+    void writeDataset(const std::string& name, const size_t* data,
+                      const std::vector<size_t>& shape, size_t row_dim = 0) override;
+    void writeDataset(const std::string& name, const double* data,
+                      const std::vector<size_t>& shape, size_t row_dim = 0) override;
+    void writeDataset(const std::string& name, const int* data,
+                      const std::vector<size_t>& shape, size_t row_dim = 0) override;
+
+    // Chunk shape of a dataset of the given shape
+    std::vector<size_t> chunkShape(const std::vector<size_t>& shape, size_t row_dim) const;
+
+private:
+    template <typename T>
+    void write(const std::string& name, const T* data, const std::vector<size_t>& shape,
+               size_t row_dim, const std::string& dtype, const std::string& fill_value, T fill);
+
+    std::string path_;
+    size_t threads_;
+    int compression_level_;
+    size_t chunk_rows_;
+    size_t chunk_cols_;
+};
@@ -0,0 +1,48 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "CloudConstructor.hpp"
+
+// Startup autotuning of CloudConstructor::SearchOptions.
+//
+// A band of output rows in the middle of the frame (about sample_pixels
+// pixels) is searched with each candidate configuration: first the search
+// engine (kd-tree leaf sizes, brute force), then thread count x tile size.
+// A candidate counts only when its donors equal the default configuration's,
+// so the winner is always exact. Results are cached per host and shape class;
+// a cached choice is rechecked against the default configuration's donors on
+// a band of sample_pixels / 8 pixels and tuned again if they differ. Thread
+// counts are capped by max_threads, also for cached choices.
+class Autotuner {
+public:
+    struct Result {
+        CloudConstructor::SearchOptions options;
+        std::string host;
+        std::string shape_class;
+        bool from_cache = false;
+        size_t candidates_timed = 0;
+        double pixels_per_second = 0.0;  // Sample throughput of the chosen options (0: from cache)
+    };
+
+    // cache_path: empty disables the cache; max_threads 0: all cores
+    explicit Autotuner(std::string cache_path, size_t sample_pixels = 4096, size_t max_threads = 0);
+
+    // Picks the fastest exact options and applies them to constructor
+    Result tune(CloudConstructor& constructor, size_t num_acclp_points, size_t k_candidates) const;
+
+    // Frame size, AC_CLP track length and k, each rounded up to a power of two
+    static std::string shapeClass(size_t num_pixels, size_t num_acclp_points, size_t k_candidates);
+    static std::string hostName();
+    // $BARKER_AUTOTUNE_CACHE, else ~/.cache/barker-autotune.txt
+    static std::string defaultCachePath();
+
+private:
+    bool loadCached(const std::string& host, const std::string& shape_class,
+                    CloudConstructor::SearchOptions& options) const;
+    void storeCached(const std::string& host, const std::string& shape_class,
+                     const CloudConstructor::SearchOptions& options) const;
+
+    std::string cache_path_;
+    size_t sample_pixels_;
+    size_t max_threads_;
+};
@@ -1,15 +1,57 @@
 #pragma once
 #include <vector>
+#include <string>
 #include <utility>
+#include <functional>
+#include <memory>
 #include "ObservationDataset.hpp"
 #include "DonorSelector.hpp"
 #include "KDTreeSearcher.hpp"
+#include "NumaTopology.hpp"
 
 class CloudConstructor {
 public:
     using Index2D = std::pair<size_t, size_t>;
     using Index3D = std::tuple<size_t, size_t, size_t>;
 
+    // Coarse-to-fine donor assignment
+    struct MultiresolutionOptions {
+        size_t block_size = 8;            // Coarse sub-grid spacing in pixels
+        double spectral_threshold = 0.1;  // Max extra log-spectrum distance of a reused donor over the exact one
+        bool validate = false;            // Also run the full search to measure agreement
+    };
+
+    struct MultiresolutionStats {
+        size_t searched_pixels = 0;
+        size_t total_pixels = 0;
+        double searched_fraction = 0.0;
+        double agreement = -1.0;          // Fraction equal to full resolution (-1: not validated)
+    };
+
+    // Search engine and parallel layout of construct(); every setting gives the same donors
+    struct SearchOptions {
+        size_t leaf_size = 10;            // Max points per kd-tree leaf
+        bool brute_force = false;         // Spectral KNN by exhaustive scan instead of the kd-tree
+        size_t tile_size = 32;            // Output tiles of tile_size x tile_size pixels
+        size_t threads = 1;               // Worker threads taking tiles
+        NumaTopology::Pinning pinning = NumaTopology::Pinning::NONE;  // Placement of the worker threads
+        bool numa_replicas = false;       // One copy of the kd-trees per NUMA node, searched by that node's workers
+    };
+
+    // Rectangle of output pixels whose donors and profiles are final
+    struct Tile {
+        size_t row;   // First output row
+        size_t col;   // First output column
+        size_t rows;
+        size_t cols;
+    };
+    using TileCallback = std::function<void(const Tile&)>;
+
+    // Called once donors are known, with the sorted unique AC_CLP and AUX rows
+    // whose profiles are mapped; loads them into the AC_CLP / AUX data
+    using ProfileLoader = std::function<void(const std::vector<size_t>& ac_rows,
+                                             const std::vector<size_t>& aux_rows)>;
+
     CloudConstructor(const MSI_RGR_Data* msi, 
                      AC_CLP_Data* acclp,
                      const AUX__2D_Data* aux2d,
@@ -23,21 +65,104 @@ public:
     // Processing function
     void construct();
 
-    // Accessors for results
-    const std::vector<size_t>& getMappedIndices() const { return mapped_indices_; }
-    const std::vector<double>& getMappedData() const { return mapped_data_; }
+    // Multiresolution: donors solved on a coarse sub-grid, refined where it is not coherent.
+    // Grid points and blocks are taken by the worker threads of the search options.
+    MultiresolutionStats constructMultiresolution(const MultiresolutionOptions& options);
+
+    // Parameter sweep: donor indices only, one [H_out, W_out] layer per criteria
+    void constructSweep(const std::vector<DonorSelector::Criteria>& criteria);
+
+    // Rebuilds the kd-trees when the leaf size changes
+    void setSearchOptions(const SearchOptions& options);
+    const SearchOptions& searchOptions() const { return search_options_; }
+
+    // Donor indices of output rows [i_begin, i_end) as [rows][W_out], searched with the current options
+    std::vector<size_t> searchRows(size_t i_begin, size_t i_end) const;
+
+    // mu0 / phi0 difference thresholds of the donor search
+    void setAngleThresholds(double delta_mu0, double delta_phi0) {
+        donor_selector_.setAngleThresholds(delta_mu0, delta_phi0);
+        for (auto& replica : replicas_) {
+            replica->selector->setAngleThresholds(delta_mu0, delta_phi0);
+        }
+    }
+
+    // Profile variables to map (indices into profileVariableNames); default: the first num_variables
+    void selectVariables(const std::vector<size_t>& variables);
+    const std::vector<size_t>& variables() const { return variables_; }
+
+    // Profiles not loaded up front are fetched through the loader for the selected donors only
+    void setProfileLoader(ProfileLoader loader) { profile_loader_ = std::move(loader); }
+
+    // Called for every finished tile, from the worker thread that finished it
+    void setTileCallback(TileCallback callback) { tile_callback_ = std::move(callback); }
+
+    // AUX index - AC_CLP index at the same point (default 100)
+    void setAuxOffset(size_t aux_offset) { DEFF_IDX_ = aux_offset; }
+    size_t auxOffset() const { return DEFF_IDX_; }
+
+    // Results are written to caller-owned buffers instead of the internal ones:
+    // mapped_indices [H_out][W_out], mapped_data [L][H_out][W_out][K] (null: internal buffer)
+    void setOutputBuffers(size_t* mapped_indices, double* mapped_data);
+
+    // Accessors for results (internal buffers; mapped_data is filled by construct)
+    const FirstTouchVector<size_t>& getMappedIndices() const { return mapped_indices_; }
+    const FirstTouchVector<double>& getMappedData() const { return mapped_data_; }
+    const std::vector<size_t>& getSweepIndices() const { return sweep_indices_; }
+
+    // Results wherever they are written
+    const size_t* mappedIndices() const { return indices_out_; }
+    const double* mappedData() const { return data_out_; }
 
     size_t height() const { return H_; }
     size_t width() const { return W_; }
     size_t verticalLevels() const { return K_; }
     size_t numVariables() const { return L_; }
+    size_t outputHeight() const { return H_out_; }
+    size_t outputWidth() const { return W_out_; }
+
+    // Number of profile variables known to mapProfile
+    static constexpr size_t NUM_PROFILE_VARIABLES = 13;
 
+    // Output names of the profile variables, in default output order
+    static const std::vector<std::string>& profileVariableNames();
+
+    // Output names of the AUX surface fields, in default output order
+    static const std::vector<std::string>& surfaceVariableNames();
+
+    // Selected surface fields (indices into surfaceVariableNames) of one donor's
+    // AUX point, flags as 0 / 1 and NaN for fields not read. Field s goes to out[s * stride].
+    static void mapSurface(const AUX__2D_Data& aux2d, size_t aux_idx, const std::vector<size_t>& variables,
+                           double* out, size_t stride = 1);
+
+    // Selected profiles of one donor, AUX levels flipped to the AC_CLP order.
+    // Level k of variable l goes to out[k * level_stride + l * variable_stride];
+    // the default strides give [K][variables.size()].
+    static void mapProfile(const AC_CLP_Data& acclp, size_t ac_idx,
+                           const AUX__2D_Data& aux2d, size_t aux_idx,
+                           size_t K, const std::vector<size_t>& variables, double* out,
+                           size_t level_stride = 0, size_t variable_stride = 1);
+
+    // mapped_data is variable-major: one [H_out][W_out][K] plane per variable
     inline size_t flatIndex(size_t i, size_t j, size_t k, size_t l) const {
-        return (((i * W_ + j) * K_ + k) * L_) + l;
+        return ((l * H_out_ + i) * W_out_ + j) * K_ + k;
     }
                      
 private:
-    void mapVariables(size_t i, size_t j, size_t ac_idx);
+    void assignDonor(size_t i, size_t j, const std::optional<DonorSelector::Donor>& donor);
+    double spectralDistance(size_t src_i, size_t src_j, size_t ac_idx) const;
+    void mapVariables();
+    void loadProfiles();
+    void buildReplicas();
+
+    // Runs fn on every tile of output rows [i_begin, i_end) on the worker threads
+    void forEachTile(size_t i_begin, size_t i_end, const std::function<void(const Tile&)>& fn) const;
+    // Donor selector of the calling worker (its node's replica, if any)
+    const DonorSelector& workerSelector() const;
+    // Donors of a tile into donors[(i - i_begin) * W_out + j]
+    void searchTile(const Tile& tile, size_t i_begin, size_t* donors) const;
+    // Profiles of a tile's donors into mapped_data (NaN without donor)
+    void mapTile(const Tile& tile);
 
     const MSI_RGR_Data* msi_;
     AC_CLP_Data* acclp_;
@@ -53,6 +178,16 @@ private:
 
     // DonorSelector
     DonorSelector donor_selector_;
+    SearchOptions search_options_;
+
+    // Copy of the kd-trees allocated on one NUMA node
+    struct SearchReplica {
+        KDTreeSearcherBand  AC_LogSpectralKDTree;
+        KDTreeSearcherCoord AC_CoordKDTree;
+        KDTreeSearcherCoord MSI_CoordKDTree;
+        std::unique_ptr<DonorSelector> selector;
+    };
+    std::vector<std::unique_ptr<SearchReplica>> replicas_;  // Per node (empty: no replicas)
 
     // Dimensions
     size_t H_;  // Height of the MSI data
@@ -64,7 +199,14 @@ private:
     size_t i_min_, i_max_, j_min_, j_max_; // Processing bounds
 
     // Results
-    std::vector<size_t> mapped_indices_;  // mapped indices (i,j) -> (k,l)
-    std::vector<double> mapped_data_;
+    FirstTouchVector<size_t> mapped_indices_; // mapped indices (i,j) -> (k,l); pages first touched by the workers
+    FirstTouchVector<double> mapped_data_;    // Pages first touched by the workers filling them
+    std::vector<size_t> sweep_indices_;   // [criteria][H_out][W_out]
+    std::vector<size_t> variables_;       // Mapped profile variables
+    size_t* indices_out_ = nullptr;       // mapped_indices_ or a caller buffer
+    double* data_out_ = nullptr;          // mapped_data_ or a caller buffer
+    bool external_data_ = false;
+    ProfileLoader profile_loader_;
+    TileCallback tile_callback_;
     size_t DEFF_IDX_ = 100; // AUX_IDX - ACCLP_IDX at the same point
 };
@@ -3,12 +3,41 @@
 #include <vector>
 #include <array>
 #include <optional>
+#include <cmath>
 #include "ObservationDataset.hpp"
 #include "KDTreeSearcher.hpp"
 
 class DonorSelector {
 public:
     using Spectrum = std::vector<double>;
+    using Donor = std::pair<size_t, double>;
+
+    // Acceptance rule of the donor search
+    struct Criteria {
+        size_t k_candidates = 100;
+        size_t max_idx_distance = 400;
+        double delta_mu0 = 30.0;
+        double delta_phi0 = 30.0;
+    };
+
+    // Geometry / surface state of an MSI pixel entering the acceptance rule
+    struct PixelState {
+        size_t row;
+        double mu0;
+        double phi0;
+        int surface_type;
+    };
+
+    // Acceptance rule of a candidate whose nearest MSI pixel is `candidate`
+    static bool isAdmissible(const PixelState& target, const PixelState& candidate,
+                             size_t max_idx_distance, double delta_mu0, double delta_phi0) {
+        size_t idx_diff = (candidate.row > target.row) ? candidate.row - target.row
+                                                       : target.row - candidate.row;
+        return idx_diff <= max_idx_distance &&
+               std::abs(candidate.mu0 - target.mu0) < delta_mu0 &&
+               std::abs(candidate.phi0 - target.phi0) < delta_phi0 &&
+               candidate.surface_type == target.surface_type;
+    }
      
     DonorSelector(const MSI_RGR_Data* msi_data,
                   const AC_CLP_Data* acclp_data,
@@ -27,12 +56,35 @@ public:
           AC_CoordKDTree_(AC_CoordKDTree),
           MSI_CoordKDTree_(MSI_CoordKDTree) {};
 
-    std::optional<std::pair<size_t, double>> findBestDonor(std::pair<size_t, size_t> msi_index) const;
+    std::optional<Donor> findBestDonor(std::pair<size_t, size_t> msi_index) const;
+
+    // Parameter sweep: one spectral search at the largest k, every criteria
+    // evaluated on the shared ordered candidate list
+    std::vector<Donor> findBestDonors(std::pair<size_t, size_t> msi_index,
+                                      const std::vector<Criteria>& criteria) const;
+
+    void setAngleThresholds(double delta_mu0, double delta_phi0) {
+        delta_mu0_ = delta_mu0;
+        delta_phi0_ = delta_phi0;
+    }
+    double deltaMu0() const { return delta_mu0_; }
+    double deltaPhi0() const { return delta_phi0_; }
 
 private:
+    using MSIIndex = std::pair<size_t, size_t>;
+
     // private member functions
     size_t findNearestACCLPindex(const std::pair<size_t, size_t>& msi_index) const;
     std::pair<size_t, size_t> findNearestMSIindex(size_t acclp_index) const;
+    KDTreeSearcherBand::Spectrum logSpectrum(const std::pair<size_t, size_t>& msi_index) const;
+    PixelState pixelState(const std::pair<size_t, size_t>& msi_index) const;
+    // First candidate (within the first k_candidates) accepted by the criteria.
+    // msi_cache holds the nearest MSI index of each candidate, filled on demand.
+    std::optional<Donor> selectCandidate(const std::pair<size_t, size_t>& target_index,
+                                         const std::vector<Donor>& candidates,
+                                         std::vector<std::optional<MSIIndex>>& msi_cache,
+                                         size_t k_candidates, size_t max_idx_distance,
+                                         double delta_mu0, double delta_phi0) const;
     
     // Data members
     const MSI_RGR_Data* msi_;
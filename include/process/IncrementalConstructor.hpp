@@ -0,0 +1,143 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include "ObservationDataset.hpp"
+#include "DonorSelector.hpp"
+#include "KDTreeSearcher.hpp"
+
+// Near-real-time cloud construction over along-track segments.
+//
+// MSI rows, AC_CLP points and AUX_2D points are appended as they arrive.
+// An AC_CLP point is indexed once its nearest MSI pixel can no longer change,
+// i.e. once MSI rows beyond it have been received. Indexed points live in a
+// log-structured set of small kd-trees; trees whose points are all farther
+// than max_idx_distance behind the next row to emit are expired.
+// An MSI row is emitted as soon as every AC_CLP point that may be admissible
+// for it is indexed, so latency scales with segment length, not frame length.
+//
+// Donors equal the batch CloudConstructor wherever the batch search finds an
+// admissible donor within its k candidates.
+class IncrementalConstructor {
+public:
+    // Finished MSI rows [first_row, first_row + num_rows), laid out as the
+    // buffers of the batch run (CloudConstructor / BarkerProcessor)
+    struct EmittedRows {
+        size_t first_row = 0;
+        size_t num_rows = 0;
+        size_t width = 0;
+        size_t K = 0;                        // Vertical levels
+        size_t L = 0;                        // Selected profile variables
+        size_t S = 0;                        // Selected surface variables
+        std::vector<size_t> mapped_indices;  // [num_rows][width], global AC_CLP index
+        std::vector<double> mapped_data;     // [L][num_rows][width][K]
+        std::vector<double> surface;         // [S][num_rows][width], flags as 0 / 1
+        std::vector<double> latitude;        // [num_rows][width]
+        std::vector<double> longitude;
+    };
+    using RowCallback = std::function<void(const EmittedRows&)>;
+
+    IncrementalConstructor(RowCallback on_rows,
+                           size_t k_candidates = 100,
+                           size_t max_idx_distance = 400,
+                           size_t num_vertical_levels = 0,
+                           size_t aux_offset = 100,
+                           size_t settle_margin = 2);
+
+    void setAngleThresholds(double delta_mu0, double delta_phi0) {
+        delta_mu0_ = delta_mu0;
+        delta_phi0_ = delta_phi0;
+    }
+
+    // Profile variables (indices into CloudConstructor::profileVariableNames) and
+    // surface variables (into surfaceVariableNames) to emit; default: all
+    void selectVariables(const std::vector<size_t>& profile_variables, const std::vector<size_t>& surface_variables);
+    const std::vector<size_t>& profileVariables() const { return variables_; }
+    const std::vector<size_t>& surfaceVariables() const { return surface_variables_; }
+
+    // Append along-track segments (in along-track order per product)
+    void appendMSI(std::unique_ptr<MSI_RGR_Data> segment);
+    void appendACCLP(std::unique_ptr<AC_CLP_Data> segment);
+    void appendAUX(std::unique_ptr<AUX__2D_Data> segment);
+
+    // Index settled AC_CLP points and emit every finished MSI row
+    void process();
+
+    // No more segments: emit all remaining rows
+    void finish();
+
+    size_t emittedRows() const { return next_row_; }
+    size_t liveTrees() const { return runs_.size(); }
+    size_t numVariables() const { return L_; }
+    size_t verticalLevels() const { return K_; }
+
+private:
+    // Along-track segment with the global index of its first element
+    template <class Data>
+    struct Segment {
+        size_t first;
+        size_t count;
+        std::unique_ptr<Data> data;
+    };
+
+    // Immutable run of indexed AC_CLP points [first, first + count)
+    struct Run {
+        size_t first;
+        size_t count;
+        size_t max_row;
+        std::vector<KDTreeSearcherBand::Spectrum> spectra;
+        std::vector<KDTreeSearcherCoord::Point> coords;
+        std::vector<DonorSelector::PixelState> pixels;
+        KDTreeSearcherBand spectral_tree;
+        KDTreeSearcherCoord coord_tree;
+    };
+
+    // AC_CLP point whose nearest MSI pixel is known
+    struct SettledPoint {
+        KDTreeSearcherBand::Spectrum spectrum;
+        KDTreeSearcherCoord::Point coord;
+        DonorSelector::PixelState pixel;
+    };
+
+    void settle();
+    void buildRuns();
+    void expire();
+    void emitRows(size_t end_row);
+    bool nearestMSIPixel(const KDTreeSearcherCoord::Point& query, size_t& row, size_t& col) const;
+    const Segment<MSI_RGR_Data>& msiSegment(size_t row) const;
+    std::unique_ptr<Run> makeRun(size_t first, std::vector<SettledPoint> points) const;
+    size_t findDonor(size_t row, size_t col) const;
+    size_t rowBound() const;
+
+    RowCallback on_rows_;
+    size_t k_candidates_;
+    size_t max_idx_distance_;
+    size_t K_;
+    size_t L_;
+    size_t aux_offset_;
+    size_t settle_margin_;
+    std::vector<size_t> variables_;         // Selected profile variables, in output order
+    std::vector<size_t> surface_variables_; // Selected surface variables, in output order
+    double delta_mu0_ = 30.0;
+    double delta_phi0_ = 30.0;
+    size_t W_ = 0;
+
+    // Inputs received so far
+    std::deque<Segment<MSI_RGR_Data>> msi_segments_;
+    std::deque<std::unique_ptr<KDTreeSearcherCoord>> msi_coord_trees_;
+    std::deque<Segment<AC_CLP_Data>> acclp_segments_;
+    std::deque<Segment<AUX__2D_Data>> aux_segments_;
+    size_t msi_rows_ = 0;
+    size_t acclp_points_ = 0;
+    size_t aux_points_ = 0;
+    bool finished_ = false;
+
+    // AC_CLP indexing state
+    size_t settled_points_ = 0;           // AC_CLP points [0, settled_points_) are settled
+    std::vector<SettledPoint> unindexed_; // Settled points not yet in a run
+    size_t last_settled_row_ = 0;
+    std::vector<std::unique_ptr<Run>> runs_;
+
+    size_t next_row_ = 0;                 // Next MSI row to emit
+};
@@ -4,6 +4,7 @@
 #include <array>
 #include <utility>  
 #include <cmath>    
+#include <algorithm>
 
 class KDTreeSearcherBand {
 public:
@@ -20,12 +21,29 @@ public:
     // Give Data
     void setData(const std::vector<Spectrum>& points) {
         cloud_.pts = points;
-        index_ = std::make_unique<KDTree_t>(7 /*dim*/, cloud_, nanoflann::KDTreeSingleIndexAdaptorParams(10));
-        index_->buildIndex();
+        buildIndex();
+    }
+
+    // Max points per kd-tree leaf; rebuilds an existing index
+    void setLeafSize(size_t leaf_size) {
+        leaf_size_ = leaf_size;
+        if (index_) buildIndex();
     }
+    size_t leafSize() const { return leaf_size_; }
+
+    // Indexed points, e.g. to build a replica
+    const auto& points() const { return cloud_.pts; }
+
+    // Exhaustive scan instead of the kd-tree (same neighbours, same distances)
+    void setBruteForce(bool brute_force) { brute_force_ = brute_force; }
+    bool bruteForce() const { return brute_force_; }
 
     // NN search
     std::pair<size_t, double> findNearest(const Spectrum& query) const {
+        if (brute_force_) {
+            auto nearest = scanKNearest(query, 1);
+            return nearest.empty() ? std::pair<size_t, double>{0, 0.0} : nearest.front();
+        }
         size_t ret_index;
         double out_dist_sqr;
         nanoflann::KNNResultSet<double> resultSet(1);
@@ -39,6 +57,9 @@ public:
 
     // KNN search 
     std::vector<std::pair<size_t, double>> findKNearest(const Spectrum& query, size_t k) const {
+        if (brute_force_) {
+            return scanKNearest(query, k);
+        }
         std::vector<size_t> indices(k);
         std::vector<double> dists(k);
     
@@ -48,15 +69,43 @@ public:
         nanoflann::SearchParameters params;
         index_->findNeighbors(resultSet, query.data(), params);
     
+        // Fewer than k points may be indexed
+        size_t found = resultSet.size();
         std::vector<std::pair<size_t, double>> results;
-        results.reserve(k);
-        for (size_t i = 0; i < k; ++i) {
+        results.reserve(found);
+        for (size_t i = 0; i < found; ++i) {
             results.emplace_back(indices[i], std::sqrt(dists[i]));
         }
         return results;
     }
 
 private:
+    void buildIndex() {
+        index_ = std::make_unique<KDTree_t>(7 /*dim*/, cloud_, nanoflann::KDTreeSingleIndexAdaptorParams(leaf_size_));
+        index_->buildIndex();
+    }
+
+    // k nearest by distance, ties by index; squared distances summed as in L2_Simple_Adaptor
+    std::vector<std::pair<size_t, double>> scanKNearest(const Spectrum& query, size_t k) const {
+        std::vector<std::pair<double, size_t>> dists(cloud_.pts.size());
+        for (size_t i = 0; i < cloud_.pts.size(); ++i) {
+            double sum = 0.0;
+            for (size_t d = 0; d < 7; ++d) {
+                double diff = query[d] - cloud_.pts[i][d];
+                sum += diff * diff;
+            }
+            dists[i] = {sum, i};
+        }
+        k = std::min(k, dists.size());
+        std::partial_sort(dists.begin(), dists.begin() + k, dists.end());
+        std::vector<std::pair<size_t, double>> results;
+        results.reserve(k);
+        for (size_t i = 0; i < k; ++i) {
+            results.emplace_back(dists[i].second, std::sqrt(dists[i].first));
+        }
+        return results;
+    }
+
     // Internal Data structure
     struct SpectrumCloud {
         std::vector<Spectrum> pts;
@@ -77,6 +126,8 @@ private:
 
     SpectrumCloud cloud_;
     std::unique_ptr<KDTree_t> index_;
+    size_t leaf_size_ = 10;
+    bool brute_force_ = false;
 };
 
 class KDTreeSearcherCoord {
@@ -94,10 +145,19 @@ public:
     // Give Data
     void setData(const std::vector<Point>& points) {
         cloud_.pts = points;
-        index_ = std::make_unique<KDTree_t>(2 /*dim*/, cloud_, nanoflann::KDTreeSingleIndexAdaptorParams(10));
-        index_->buildIndex();
+        buildIndex();
     }
 
+    // Max points per kd-tree leaf; rebuilds an existing index
+    void setLeafSize(size_t leaf_size) {
+        leaf_size_ = leaf_size;
+        if (index_) buildIndex();
+    }
+    size_t leafSize() const { return leaf_size_; }
+
+    // Indexed points, e.g. to build a replica
+    const auto& points() const { return cloud_.pts; }
+
     // KNN search
     std::pair<size_t, double> findNearest(const Point& query) const {
         size_t ret_index;
@@ -112,6 +172,11 @@ public:
     }
 
 private:
+    void buildIndex() {
+        index_ = std::make_unique<KDTree_t>(2 /*dim*/, cloud_, nanoflann::KDTreeSingleIndexAdaptorParams(leaf_size_));
+        index_->buildIndex();
+    }
+
     // Internal Data structure
     struct PointCloud {
         std::vector<Point> pts;
@@ -132,5 +197,6 @@ private:
 
     PointCloud cloud_;
     std::unique_ptr<KDTree_t> index_;
+    size_t leaf_size_ = 10;
 };
 
@@ -0,0 +1,100 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+#include <new>
+#include <sys/mman.h>
+
+// NUMA nodes and CPUs of this host, read once from /sys/devices/system/node.
+// Hosts without that information are treated as a single node holding every CPU.
+class NumaTopology {
+public:
+    // Placement of worker threads
+    enum class Pinning {
+        NONE,     // Left to the scheduler
+        COMPACT,  // Fill the CPUs of one node before the next
+        SCATTER   // Round-robin over the nodes
+    };
+
+    // Page allocation counters of /sys/devices/system/node/node*/numastat, summed over the nodes.
+    // They count pages allocated system-wide, not accesses of this process.
+    struct Counters {
+        bool available = false;
+        uint64_t numa_hit = 0;    // Allocated on the intended node
+        uint64_t numa_miss = 0;   // Allocated elsewhere because the intended node was full
+        uint64_t local_node = 0;  // Allocated on the node of the allocating CPU
+        uint64_t other_node = 0;  // Allocated on another node than the allocating CPU's
+    };
+
+    static const NumaTopology& system();
+
+    // Nodes with CPUs usable by this process, numbered 0 .. numNodes() - 1
+    size_t numNodes() const { return node_cpus_.size(); }
+    const std::vector<int>& cpus(size_t node) const { return node_cpus_[node]; }
+    size_t nodeOfCpu(int cpu) const;
+    // Node of the CPU the calling thread runs on
+    size_t currentNode() const;
+
+    // CPU of worker thread `worker` under the pinning policy (-1: not pinned)
+    int cpuForWorker(size_t worker, Pinning pinning) const;
+
+    // Restricts the calling thread to the given CPUs; false if the kernel refused
+    static bool pinCurrentThread(const std::vector<int>& cpus);
+
+    static Counters readCounters();
+
+    // Resident pages of [data, data + bytes) on each node; pages not touched yet
+    // or on nodes without usable CPUs are not counted
+    std::vector<size_t> pagesPerNode(const void* data, size_t bytes) const;
+
+    static Pinning parsePinning(const std::string& name);
+    static const char* pinningName(Pinning pinning);
+
+private:
+    NumaTopology();
+
+    std::vector<int> node_ids_;                 // Kernel node id of each node
+    std::vector<std::vector<int>> node_cpus_;  // CPUs usable by this process, per node
+    std::vector<size_t> cpu_node_;              // Node of each CPU id
+};
+
+// Allocator leaving elements of trivial types uninitialised on resize, so the
+// pages of a large buffer are first touched by the threads that fill them.
+// Blocks of kMapBytes or more are mapped straight from the kernel: malloc may
+// hand out heap pages that another thread has already touched.
+template <typename T>
+struct FirstTouchAllocator : std::allocator<T> {
+    template <typename U> struct rebind { using other = FirstTouchAllocator<U>; };
+    static constexpr size_t kMapBytes = size_t(64) << 10;
+
+    FirstTouchAllocator() = default;
+    template <typename U> FirstTouchAllocator(const FirstTouchAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        if (n * sizeof(T) < kMapBytes) {
+            return std::allocator<T>::allocate(n);
+        }
+        void* block = mmap(nullptr, n * sizeof(T), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (block == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(block);
+    }
+    void deallocate(T* p, size_t n) {
+        if (n * sizeof(T) < kMapBytes) {
+            std::allocator<T>::deallocate(p, n);
+        } else {
+            munmap(p, n * sizeof(T));
+        }
+    }
+
+    template <typename U>
+    void construct(U* p) { ::new (static_cast<void*>(p)) U; }
+    template <typename U, typename... Args>
+    void construct(U* p, Args&&... args) { ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...); }
+};
+
+template <typename T> using FirstTouchVector = std::vector<T, FirstTouchAllocator<T>>;
@@ -0,0 +1,20 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+
+// Items [0, num_items) processed by a pool of worker threads.
+//
+// Workers take items in order. The first exception stops the remaining items
+// and is rethrown to the caller once every worker has returned. A pool of one
+// worker runs on the calling thread.
+class WorkerPool {
+public:
+    // Workers used for num_items items: threads, at most one per item and at least one
+    static size_t workers(size_t num_items, size_t threads);
+
+    // start(worker) runs once in each worker before its first item (e.g. to pin it
+    // or to allocate its scratch buffers); fn(item, worker) runs once per item
+    static void run(size_t num_items, size_t threads,
+                    const std::function<void(size_t worker)>& start,
+                    const std::function<void(size_t item, size_t worker)>& fn);
+};
@@ -1,14 +1,143 @@
 #include <iostream>
+#include <fstream>
+#include <sstream>
 #include <memory>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+#include <chrono>
 #include "MSI_RGR_Reader.hpp"
 #include "AC_CLP_Reader.hpp"
 #include "AUX__2D_Reader.hpp"
-#include "HDF5Writer.hpp"
-#include "CloudConstructor.hpp"
+#include "RunProfile.hpp"
+#include "Barker.hpp"
+#include "SegmentWatcher.hpp"
+#include "Autotuner.hpp"
+#ifdef BARKER_USE_MPI
+#include <mpi.h>
+
+// MPI_Init / MPI_Finalize around the whole run
+class MPISession {
+public:
+    MPISession(int* argc, char*** argv) { MPI_Init(argc, argv); }
+    ~MPISession() { MPI_Finalize(); }
+
+    int rank() const { int r = 0; MPI_Comm_rank(MPI_COMM_WORLD, &r); return r; }
+    int size() const { int n = 1; MPI_Comm_size(MPI_COMM_WORLD, &n); return n; }
+};
+
+// Tuned search options of rank 0 on every rank; thread placement stays per rank
+static CloudConstructor::SearchOptions broadcastSearchOptions(const CloudConstructor::SearchOptions& options) {
+    unsigned long long fields[4] = {options.leaf_size, options.brute_force ? 1ULL : 0ULL,
+                                    options.tile_size, options.threads};
+    MPI_Bcast(fields, 4, MPI_UNSIGNED_LONG_LONG, 0, MPI_COMM_WORLD);
+    CloudConstructor::SearchOptions received = options;
+    received.leaf_size = static_cast<size_t>(fields[0]);
+    received.brute_force = fields[1] != 0;
+    received.tile_size = static_cast<size_t>(fields[2]);
+    received.threads = static_cast<size_t>(fields[3]);
+    return received;
+}
+#endif
+
+// Comma-separated variable list; every name must be a profile or surface variable
+static std::vector<std::string> parseVariableList(const std::string& list) {
+    const auto& profile_names = BarkerProcessor::profileVariableNames();
+    const auto& surface_names = BarkerProcessor::surfaceVariableNames();
+    std::vector<std::string> names;
+    std::stringstream fields(list);
+    std::string name;
+    while (std::getline(fields, name, ',')) {
+        if (name.empty()) continue;
+        if (std::find(profile_names.begin(), profile_names.end(), name) == profile_names.end() &&
+            std::find(surface_names.begin(), surface_names.end(), name) == surface_names.end()) {
+            throw std::invalid_argument("Unknown variable " + name);
+        }
+        names.push_back(name);
+    }
+    return names;
+}
+
+// Sweep file: one configuration per line
+//   <k_candidates> <max_idx_distance> <delta_mu0> <delta_phi0>
+static std::vector<DonorSelector::Criteria> readSweepFile(const std::string& filepath) {
+    std::ifstream in(filepath);
+    if (!in) {
+        throw std::runtime_error("Cannot open sweep file: " + filepath);
+    }
+    std::vector<DonorSelector::Criteria> criteria;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream fields(line);
+        DonorSelector::Criteria c;
+        if (!(fields >> c.k_candidates >> c.max_idx_distance >> c.delta_mu0 >> c.delta_phi0)) {
+            throw std::runtime_error("Malformed sweep line: " + line);
+        }
+        criteria.push_back(c);
+    }
+    return criteria;
+}
+
+// Near-real-time mode: arguments of the segment watcher
+static int runIncremental(int argc, char** argv) {
+    if (argc < 4) {
+        std::cerr << "Usage: " << argv[0] << " --incremental <Segment_Dir> <Output_Dir>"
+                  << " [--poll-seconds <s>] [--delta-mu0 <deg>] [--delta-phi0 <deg>] [--variables <Name,...>]"
+                  << " [--format <hdf5|zarr>]" << std::endl;
+        return 1;
+    }
+    SegmentWatcher::Options options;
+    for (int a = 4; a < argc; ++a) {
+        std::string option = argv[a];
+        if (a + 1 >= argc) {
+            throw std::invalid_argument("Missing value for option " + option);
+        }
+        if (option == "--poll-seconds") {
+            options.poll_seconds = std::stod(argv[++a]);
+        } else if (option == "--delta-mu0") {
+            options.delta_mu0 = std::stod(argv[++a]);
+        } else if (option == "--delta-phi0") {
+            options.delta_phi0 = std::stod(argv[++a]);
+        } else if (option == "--variables") {
+            options.variables = parseVariableList(argv[++a]);
+        } else if (option == "--format") {
+            options.format = argv[++a];
+        } else {
+            throw std::invalid_argument("Unknown option " + option);
+        }
+    }
+    SegmentWatcher(argv[2], argv[3], options).run();
+    return 0;
+}
 
 int main(int argc, char** argv) {
-    if (argc != 7) {
-        std::cerr << "Usage: " << argv[0] << " <MSI_RGR_File> <AC_CLP_File> <AUX_2D_File> <Output_HDF5_File> <Index_Min> <Index_Max>" << std::endl;
+#ifdef BARKER_USE_MPI
+    MPISession mpi(&argc, &argv);
+#endif
+    if (argc >= 2 && std::string(argv[1]) == "--incremental") {
+        try {
+#ifdef BARKER_USE_MPI
+            if (mpi.size() > 1) {
+                throw std::invalid_argument("--incremental runs on a single process");
+            }
+#endif
+            return runIncremental(argc, argv);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "[main] Error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    if (argc < 7) {
+        std::cerr << "Usage: " << argv[0] << " <MSI_RGR_File> <AC_CLP_File> <AUX_2D_File> <Output_HDF5_File> <Index_Min> <Index_Max>"
+                  << " [--delta-mu0 <deg>] [--delta-phi0 <deg>] [--variables <Name,...>] [--sweep <Sweep_File>]"
+                  << " [--multires <Block_Size> [--multires-threshold <Distance>] [--multires-validate]]"
+                  << " [--threads <n>] [--pin <none|compact|scatter>] [--numa-replicas] [--format <hdf5|zarr>]"
+                  << " [--autotune [--autotune-cache <File>]]" << std::endl;
+        std::cerr << "       " << argv[0] << " --incremental <Segment_Dir> <Output_Dir> [--poll-seconds <s>]" << std::endl;
         return 1;
     }
 
@@ -20,149 +149,198 @@ int main(int argc, char** argv) {
         std::string idx_min          = argv[5];
         std::string idx_max          = argv[6];
 
+        BarkerProcessor::Options options;
+        std::string sweep_filepath;
+        std::string output_format = "hdf5";
+        options.autotune_cache = Autotuner::defaultCachePath();
+        bool threads_given = false;
+        for (int a = 7; a < argc; ++a) {
+            std::string option = argv[a];
+            if (option == "--multires-validate") {
+                options.multires.validate = true;
+                continue;
+            }
+            if (option == "--autotune") {
+                options.autotune = true;
+                continue;
+            }
+            if (option == "--numa-replicas") {
+                options.search.numa_replicas = true;
+                continue;
+            }
+            if (a + 1 >= argc) {
+                throw std::invalid_argument("Missing value for option " + option);
+            }
+            if (option == "--delta-mu0") {
+                options.delta_mu0 = std::stod(argv[++a]);
+            } else if (option == "--delta-phi0") {
+                options.delta_phi0 = std::stod(argv[++a]);
+            } else if (option == "--threads") {
+                options.search.threads = static_cast<size_t>(std::stoul(argv[++a]));
+                threads_given = true;
+                if (options.search.threads == 0) {
+                    options.search.threads = std::max(1u, std::thread::hardware_concurrency());
+                }
+            } else if (option == "--format") {
+                output_format = argv[++a];
+                if (output_format != "hdf5" && output_format != "zarr") {
+                    throw std::invalid_argument("Unknown output format " + output_format + " (hdf5, zarr)");
+                }
+            } else if (option == "--pin") {
+                options.search.pinning = NumaTopology::parsePinning(argv[++a]);
+            } else if (option == "--autotune-cache") {
+                options.autotune_cache = argv[++a];
+            } else if (option == "--variables") {
+                options.variables = parseVariableList(argv[++a]);
+            } else if (option == "--sweep") {
+                sweep_filepath = argv[++a];
+            } else if (option == "--multires") {
+                options.multires_block = static_cast<size_t>(std::stoul(argv[++a]));
+            } else if (option == "--multires-threshold") {
+                options.multires.spectral_threshold = std::stod(argv[++a]);
+            } else {
+                throw std::invalid_argument("Unknown option " + option);
+            }
+        }
+        // With --autotune, --threads caps the thread counts tried
+        if (options.autotune && threads_given) {
+            options.autotune_max_threads = options.search.threads;
+        }
         std::cout << "[main] Starting cloud construction processing" << std::endl;
+        auto run_start = std::chrono::steady_clock::now();
+        auto elapsedSeconds = [](std::chrono::steady_clock::time_point start) {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        };
 
         // Read input file //
+        // AC_CLP / AUX profiles are gathered after the donor search, for the selected donors only
         std::cout << "[main] Reading MSI data from: " << msi_filepath << std::endl;
         std::unique_ptr<MSI_RGR_Data> msi_data = MSI_Reader::read(msi_filepath);
-        std::cout << "[main] Reading AC_CLP data from: " << acclp_filepath << std::endl;
-        std::unique_ptr<AC_CLP_Data> acclp_data = AC_CLP_Reader::read(acclp_filepath);
-        std::cout << "[main] Reading AUX_2D data from: " << aux2d_filepath << std::endl;
-        std::unique_ptr<AUX__2D_Data> aux2d_data = AUX__2D_Reader::read(aux2d_filepath);
+        std::cout << "[main] Reading AC_CLP geometry from: " << acclp_filepath << std::endl;
+        std::unique_ptr<AC_CLP_Data> acclp_data = AC_CLP_Reader::readGeometry(acclp_filepath);
+        std::cout << "[main] Reading AUX_2D geometry from: " << aux2d_filepath << std::endl;
+        std::unique_ptr<AUX__2D_Data> aux2d_data = AUX__2D_Reader::readGeometry(aux2d_filepath);
 
-        // Construct cloud field //
-        size_t k_candidates = 100;
-        size_t max_idx_distance = 2000;
-        size_t num_vartical_levels = acclp_data->height[0].size();
-        size_t num_variables = 13;
-
-        size_t DIFF_IDX = 100; // AUX_IDX - ACCLP_IDX at the same point
-        size_t i_min = static_cast<size_t>(std::stoi(idx_min)); 
+        size_t i_min = static_cast<size_t>(std::stoi(idx_min));
         size_t i_max = static_cast<size_t>(std::stoi(idx_max));
-        // size_t i_min = 2500, i_max = 3499;
-        size_t j_min = 0, j_max = msi_data->longitude[0].size() - 1;
-        size_t H_out = i_max - i_min + 1;
-        size_t W_out = j_max - j_min + 1;
-
-        std::cout << "[main] Initializing CloudConstructor" << std::endl;
-        CloudConstructor constructor(msi_data.get(), acclp_data.get(), aux2d_data.get(),
-                                     k_candidates, max_idx_distance, num_vartical_levels, num_variables,
-                                     i_min, i_max, j_min, j_max);
-
-        std::cout << "[main] Constructing cloud field" << std::endl;
-        constructor.construct();
-
-        // Output to HDF5 file //
-        std::vector<std::string> variable_names = {
-            "cloud_effective_radius1",
-            "cloud_effective_radius2",
-            "cloud_water_content1",
-            "cloud_water_content2",
-            "cloud_phase1",
-            "cloud_phase2",
-            "radar_lidar_flag",
-            "height",
-            "ozoneMassMixingRatio",
-            "pressure",
-            "specificHumidity",
-            "temperature",
-            "height_aux"
-        };
+        if (i_max < i_min) {
+            throw std::invalid_argument("Index_Max is smaller than Index_Min");
+        }
+        size_t total_rows = i_max - i_min + 1;
+        size_t row_offset = 0;  // First output row of this process
+#ifdef BARKER_USE_MPI
+        // Ranks split the row range into contiguous blocks
+        size_t num_ranks = static_cast<size_t>(mpi.size());
+        size_t rank = static_cast<size_t>(mpi.rank());
+        if (num_ranks > total_rows) {
+            throw std::invalid_argument("More MPI ranks than rows in [Index_Min, Index_Max]");
+        }
+        size_t rows_per_rank = total_rows / num_ranks;
+        size_t extra_rows = total_rows % num_ranks;
+        row_offset = rank * rows_per_rank + std::min(rank, extra_rows);
+        i_min += row_offset;
+        i_max = i_min + rows_per_rank + (rank < extra_rows ? 1 : 0) - 1;
+        std::cout << "[main] Rank " << rank << " / " << num_ranks << ": rows " << i_min << " - " << i_max << std::endl;
+        if (output_format == "zarr" && num_ranks > 1) {
+            throw std::invalid_argument("--format zarr runs on a single process");
+        }
+#endif
+        std::string profile_filepath = output_filepath + ".profile";
+#ifdef BARKER_USE_MPI
+        profile_filepath = output_filepath + ".rank" + std::to_string(rank) + ".profile";
+#endif
+        if (i_max >= msi_data->height()) {
+            throw std::out_of_range("Index_Max is outside the MSI frame");
+        }
+        options.i_min = i_min;
+        options.i_max = i_max;
 
-        std::cout << "[main] Writing output to: " << output_filepath << std::endl;
-        HDF5_Writer writer(output_filepath);
-
-        std::cout << "[main:debug] "
-                  << ", height: " << constructor.height()
-                  << ", width: " << constructor.width() 
-                  << ", H_out: " << H_out
-                  << ", W_out: " << W_out
-                  << "sizeof mapped indices: " << constructor.getMappedIndices().size() << std::endl;
-
-        writer.writeDataset("mapped_indices",
-                            constructor.getMappedIndices(),
-                            {constructor.height(), constructor.width()});
-
-        std::cout << "[main] Writing mapped indices completed" << std::endl;
-        std::cout << "[main] Writing mapped data" << std::endl;
-
-        const auto& mapped_data = constructor.getMappedData();
-        size_t H = constructor.height();
-        size_t W = constructor.width();
-        size_t K = constructor.verticalLevels();
-        size_t L = constructor.numVariables();
-
-        for (size_t l = 0; l < L; ++l) {
-            std::vector<double> single_variable(H_out * W_out * K);
-            size_t offset = l;
-
-            for (size_t i = 0; i < H_out; ++i) {
-                for (size_t j = 0; j < W_out; ++j) {
-                    for (size_t k = 0; k < K; ++k) {
-                        // size_t src_idx = (((i + i_min) * W + (j + j_min)) * K + k) * L + offset;
-                        size_t src_idx = ((i * W_out + j) * K + k) * L + offset;
-                        size_t dst_idx = (i * W_out + j) * K + k;
-                        single_variable[dst_idx] = mapped_data[src_idx];
-                    }
-                }
+        // Construct cloud field //
+        std::cout << "[main] Initializing cloud construction" << std::endl;
+        std::unique_ptr<BarkerProcessor> processor_ptr;
+#ifdef BARKER_USE_MPI
+        if (options.autotune && num_ranks > 1) {
+            // Rank 0 tunes, the other ranks wait and take its choice
+            if (rank == 0) {
+                processor_ptr = std::make_unique<BarkerProcessor>(*msi_data, *acclp_data, *aux2d_data, options);
             }
-            writer.writeDataset(variable_names[l],
-                                single_variable,
-                                {H_out, W_out, K});
-        }
-
-        std::vector<double> latitude_variable(H_out * W_out);
-        std::vector<double> longitude_variable(H_out * W_out);
-
-        std::vector<size_t> ac_mapped_indices = constructor.getMappedIndices();
-        std::vector<double> surfacePressure_variable(H_out * W_out);
-        std::vector<double> totalColumnOzone_variable(H_out * W_out);
-        std::vector<double> totalColumnWaterVapor_variable(H_out * W_out);
-        std::vector<int> day_night_flag_variable(H_out * W_out);
-        std::vector<int> land_water_flag_variable(H_out * W_out);
-
-        for (size_t idx = 0; idx < H_out * W_out; ++idx) {
-            size_t h = idx / W_out;
-            size_t w = idx % W_out;
-            size_t src_h = h + i_min;
-            size_t src_w = w + j_min;
-            size_t ac_idx   = ac_mapped_indices[h * W_out + w];
-            size_t aux_idx  = ac_idx + DIFF_IDX;
-            if (aux_idx >= aux2d_data->surfacePressure.size()) {
-                throw std::out_of_range("AUX index out of range");
+            options.search = broadcastSearchOptions(rank == 0 ? processor_ptr->searchOptions() : options.search);
+            if (rank != 0) {
+                options.autotune = false;
+                processor_ptr = std::make_unique<BarkerProcessor>(*msi_data, *acclp_data, *aux2d_data, options);
+                processor_ptr->profile().set("search.source", "autotune-rank0");
             }
+        }
+#endif
+        if (!processor_ptr) {
+            processor_ptr = std::make_unique<BarkerProcessor>(*msi_data, *acclp_data, *aux2d_data, options);
+        }
+        BarkerProcessor& processor = *processor_ptr;
+        // The lazy profile readers gather the selected variables only
+        std::vector<std::string> variables = processor.profileVariables();
+        variables.insert(variables.end(), processor.surfaceVariables().begin(), processor.surfaceVariables().end());
+        processor.setProfileLoader([&](const std::vector<size_t>& ac_rows, const std::vector<size_t>& aux_rows) {
+            AC_CLP_Reader::readProfiles(acclp_filepath, ac_rows, variables, *acclp_data);
+            AUX__2D_Reader::readProfiles(aux2d_filepath, aux_rows, variables, *aux2d_data);
+        });
 
-            latitude_variable[idx]  = msi_data->latitude[src_h][src_w];
-            longitude_variable[idx] = msi_data->longitude[src_h][src_w];
+        RunProfile& profile = processor.profile();
+        profile.set("input.msi", msi_filepath);
+        profile.set("input.acclp", acclp_filepath);
+        profile.set("input.aux2d", aux2d_filepath);
+        profile.set("timing.setup_seconds", elapsedSeconds(run_start));
 
-            if (ac_idx == std::numeric_limits<size_t>::max()) {
-                surfacePressure_variable[idx]       = std::numeric_limits<double>::quiet_NaN();
-                totalColumnOzone_variable[idx]      = std::numeric_limits<double>::quiet_NaN();
-                totalColumnWaterVapor_variable[idx] = std::numeric_limits<double>::quiet_NaN();
-                day_night_flag_variable[idx]        = -1;
-                land_water_flag_variable[idx]       = -1;
-            } else {
-                surfacePressure_variable[idx]       = aux2d_data->surfacePressure[aux_idx];
-                totalColumnOzone_variable[idx]      = aux2d_data->totalColumnOzone[aux_idx];
-                totalColumnWaterVapor_variable[idx] = aux2d_data->totalColumnWaterVapor[aux_idx];
-                day_night_flag_variable[idx]        = aux2d_data->day_night_flag[aux_idx];
-                land_water_flag_variable[idx]       = aux2d_data->land_water_flag[aux_idx];
+        if (!sweep_filepath.empty()) {
+            std::vector<DonorSelector::Criteria> criteria = readSweepFile(sweep_filepath);
+            std::cout << "[main] Running parameter sweep from: " << sweep_filepath << std::endl;
+            std::vector<size_t> sweep_indices(criteria.size() * processor.mappedIndicesSize());
+            processor.runSweep(criteria, sweep_indices.data());
+
+            std::cout << "[main] Writing sweep output to: " << output_filepath << std::endl;
+            processor.write(*BarkerProcessor::openOutput(output_filepath, output_format, options.search.threads,
+                                                         row_offset, total_rows));
+            profile.set("timing.total_seconds", elapsedSeconds(run_start));
+            profile.write(profile_filepath);
+            std::cout << "[main] Parameter sweep completed successfully" << std::endl;
+            return 0;
+        }
+
+        std::cout << "[main] Constructing cloud field" << std::endl;
+        // Left uninitialised: each tile's pages are first touched by the worker that fills it
+        FirstTouchVector<size_t> mapped_indices(processor.mappedIndicesSize());
+        FirstTouchVector<double> profiles(processor.profilesSize());
+        FirstTouchVector<double> surface(processor.surfaceSize());
+        BarkerProcessor::Buffers buffers;
+        buffers.mapped_indices = mapped_indices.data();
+        buffers.profiles = profiles.data();
+        buffers.surface = surface.data();
+        processor.run(buffers);
+        if (options.multires_block > 0) {
+            const auto& stats = processor.multiresolutionStats();
+            std::cout << "[main] Multiresolution searched fraction: " << stats.searched_fraction;
+            if (options.multires.validate) {
+                std::cout << ", agreement with full resolution: " << stats.agreement;
             }
+            std::cout << std::endl;
         }
-        std::cout << "[main:debug] Writing auxiliary data completed" << std::endl;
 
-        writer.writeDataset("latitude", latitude_variable, {H_out, W_out});
-        writer.writeDataset("longitude", longitude_variable, {H_out, W_out});
-        writer.writeDataset("surfacePressure", surfacePressure_variable, {H_out, W_out});
-        writer.writeDataset("totalColumnOzone", totalColumnOzone_variable, {H_out, W_out});
-        writer.writeDataset("totalColumnWaterVapor", totalColumnWaterVapor_variable, {H_out, W_out});
-        writer.writeDataset("day_night_flag", day_night_flag_variable, {H_out, W_out});
-        writer.writeDataset("land_water_flag", land_water_flag_variable, {H_out, W_out});
+        std::cout << "[main] Writing output to: " << output_filepath << std::endl;
+        processor.write(*BarkerProcessor::openOutput(output_filepath, output_format, options.search.threads,
+                                                     row_offset, total_rows));
+        profile.set("output.format", output_format);
 
+        profile.set("timing.total_seconds", elapsedSeconds(run_start));
+        profile.write(profile_filepath);
         std::cout << "[main] Cloud construction completed successfully" << std::endl;
     }
     catch (const std::exception& e) {
         std::cerr << "[main] Error: " << e.what() << std::endl;
+#ifdef BARKER_USE_MPI
+        // The other ranks may be waiting in a collective call
+        if (mpi.size() > 1) {
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+#endif
         return 1;
     }
     return 0;
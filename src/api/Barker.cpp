@@ -0,0 +1,283 @@
+#include "Barker.hpp"
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include "Autotuner.hpp"
+#include "HDF5Writer.hpp"
+#include "ZarrWriter.hpp"
+
+namespace {
+
+double elapsedSeconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+const std::vector<std::string>& BarkerProcessor::profileVariableNames() {
+    return CloudConstructor::profileVariableNames();
+}
+
+const std::vector<std::string>& BarkerProcessor::surfaceVariableNames() {
+    return CloudConstructor::surfaceVariableNames();
+}
+
+void BarkerProcessor::selectVariables(const std::vector<std::string>& names,
+                                      std::vector<size_t>& profile_ids, std::vector<size_t>& surface_ids) {
+    const auto& profile_names = profileVariableNames();
+    const auto& surface_names = surfaceVariableNames();
+    for (const auto& name : names) {
+        if (std::find(profile_names.begin(), profile_names.end(), name) == profile_names.end() &&
+            std::find(surface_names.begin(), surface_names.end(), name) == surface_names.end()) {
+            throw std::invalid_argument("Unknown variable " + name);
+        }
+    }
+    auto select = [&names](const std::vector<std::string>& known, std::vector<size_t>& ids) {
+        ids.clear();
+        for (size_t v = 0; v < known.size(); ++v) {
+            if (names.empty() || std::find(names.begin(), names.end(), known[v]) != names.end()) {
+                ids.push_back(v);
+            }
+        }
+    };
+    select(profile_names, profile_ids);
+    select(surface_names, surface_ids);
+}
+
+std::unique_ptr<DatasetWriter> BarkerProcessor::openOutput(const std::string& path, const std::string& format,
+                                                           size_t threads, size_t row_offset, size_t total_rows) {
+    if (format == "zarr") {
+        return std::make_unique<Zarr_Writer>(path, threads);
+    }
+    if (format != "hdf5") {
+        throw std::invalid_argument("Unknown output format " + format + " (hdf5, zarr)");
+    }
+#ifdef BARKER_USE_MPI
+    return std::make_unique<HDF5_Writer>(path, MPI_COMM_WORLD, row_offset, total_rows);
+#else
+    (void)row_offset;
+    (void)total_rows;
+    return std::make_unique<HDF5_Writer>(path);
+#endif
+}
+
+void BarkerProcessor::writeSurface(DatasetWriter& writer, const std::vector<std::string>& names,
+                                   const double* surface, size_t H_out, size_t W_out) {
+    for (size_t s = 0; s < names.size(); ++s) {
+        const double* plane = surface + s * H_out * W_out;
+        if (names[s] == "day_night_flag" || names[s] == "land_water_flag") {
+            std::vector<int> flags(H_out * W_out);
+            for (size_t idx = 0; idx < flags.size(); ++idx) {
+                flags[idx] = std::isnan(plane[idx]) ? -1 : static_cast<int>(plane[idx]);
+            }
+            writer.writeDataset(names[s], flags, {H_out, W_out});
+        } else {
+            writer.writeDataset(names[s], plane, {H_out, W_out});
+        }
+    }
+}
+
+size_t BarkerProcessor::lastRow(const MSI_RGR_Data& msi, const Options& options) {
+    if (msi.height() == 0 || msi.width() == 0) {
+        throw std::invalid_argument("MSI input is empty");
+    }
+    size_t i_max = std::min(options.i_max, msi.height() - 1);
+    if (i_max < options.i_min) {
+        throw std::invalid_argument("Row range is empty or outside the MSI input");
+    }
+    return i_max;
+}
+
+BarkerProcessor::BarkerProcessor(const MSI_RGR_Data& msi, AC_CLP_Data& acclp, const AUX__2D_Data& aux2d,
+                                 const Options& options)
+    : msi_(msi),
+      aux2d_(aux2d),
+      options_(options),
+      i_min_(options.i_min),
+      constructor_(&msi, &acclp, &aux2d, options.k_candidates, options.max_idx_distance,
+                   acclp.vertical_levels, 0, options.i_min, lastRow(msi, options), 0, msi.width() - 1)
+{
+    auto setup_start = std::chrono::steady_clock::now();
+    std::vector<size_t> profile_ids;
+    selectVariables(options_.variables, profile_ids, surface_ids_);
+    for (size_t v : profile_ids) {
+        profile_variables_.push_back(profileVariableNames()[v]);
+    }
+    for (size_t v : surface_ids_) {
+        surface_variables_.push_back(surfaceVariableNames()[v]);
+    }
+    // Every AC_CLP point must have its AUX row, checked before any profile is read
+    if (acclp.longitude.size() + options_.aux_offset > aux2d.longitude.size()) {
+        throw std::out_of_range("AUX index out of range: " + std::to_string(acclp.longitude.size()) +
+                                " AC_CLP points + AUX offset " + std::to_string(options_.aux_offset) +
+                                " exceed " + std::to_string(aux2d.longitude.size()) + " AUX points");
+    }
+    constructor_.setAngleThresholds(options_.delta_mu0, options_.delta_phi0);
+    constructor_.setAuxOffset(options_.aux_offset);
+    constructor_.selectVariables(profile_ids);
+
+    size_t i_max = i_min_ + outputHeight() - 1;
+    profile_.set("rows", std::to_string(i_min_) + "-" + std::to_string(i_max));
+    profile_.set("width", outputWidth());
+    profile_.set("acclp_points", acclp.longitude.size());
+    profile_.set("k_candidates", options_.k_candidates);
+    profile_.set("max_idx_distance", options_.max_idx_distance);
+
+    // Search engine, leaf size, tile size and thread count //
+    if (options_.autotune) {
+        Autotuner tuner(options_.autotune_cache, 4096, options_.autotune_max_threads);
+        auto tuned = tuner.tune(constructor_, acclp.longitude.size(), options_.k_candidates);
+        profile_.set("search.source", tuned.from_cache ? "autotune-cache" : "autotune");
+        profile_.set("autotune.host", tuned.host);
+        profile_.set("autotune.shape_class", tuned.shape_class);
+        profile_.set("autotune.cache", options_.autotune_cache);
+        profile_.set("autotune.candidates_timed", tuned.candidates_timed);
+        if (!tuned.from_cache) {
+            profile_.set("autotune.estimated_pixels_per_second", tuned.pixels_per_second);
+        }
+    } else {
+        constructor_.setSearchOptions(options_.search);
+        profile_.set("search.source", "default");
+    }
+    const auto& search_options = constructor_.searchOptions();
+    profile_.set("search.engine", search_options.brute_force ? "brute" : "kd");
+    profile_.set("search.leaf_size", search_options.leaf_size);
+    profile_.set("search.tile_size", search_options.tile_size);
+    profile_.set("search.threads", search_options.threads);
+    profile_.set("search.pinning", NumaTopology::pinningName(search_options.pinning));
+    profile_.set("search.numa_replicas", search_options.numa_replicas);
+    profile_.set("timing.index_seconds", elapsedSeconds(setup_start));
+}
+
+void BarkerProcessor::run(const Buffers& buffers, TileCallback on_tile) {
+    constructor_.setOutputBuffers(buffers.mapped_indices, buffers.profiles);
+    double* surface = buffers.surface;
+    surface_ = surface;
+    last_run_ = LastRun::CONSTRUCT;
+    if (surface || on_tile) {
+        constructor_.setTileCallback([this, surface, on_tile](const Tile& tile) {
+            if (surface) fillSurface(tile, surface);
+            if (on_tile) on_tile(tile);
+        });
+    } else {
+        constructor_.setTileCallback(nullptr);
+    }
+
+    NumaTopology::Counters counters_before = NumaTopology::readCounters();
+    auto construct_start = std::chrono::steady_clock::now();
+    if (options_.multires_block > 0) {
+        CloudConstructor::MultiresolutionOptions multires = options_.multires;
+        multires.block_size = options_.multires_block;
+        multires_stats_ = constructor_.constructMultiresolution(multires);
+        profile_.set("mode", "multires");
+        profile_.set("multires.searched_fraction", multires_stats_.searched_fraction);
+    } else {
+        constructor_.construct();
+        profile_.set("mode", "construct");
+    }
+    profile_.set("timing.construct_seconds", elapsedSeconds(construct_start));
+    recordPlacement(counters_before);
+}
+
+// Node of every resident page of the profiles, and the system-wide page
+// allocation counters over the run (other processes count as well)
+void BarkerProcessor::recordPlacement(const NumaTopology::Counters& before) {
+    const NumaTopology& topology = NumaTopology::system();
+    NumaTopology::Counters after = NumaTopology::readCounters();
+    profile_.set("numa.nodes", topology.numNodes());
+    auto pages = topology.pagesPerNode(constructor_.mappedData(), profilesSize() * sizeof(double));
+    for (size_t node = 0; node < pages.size(); ++node) {
+        profile_.set("numa.profile_pages.node" + std::to_string(node), pages[node]);
+    }
+    if (before.available && after.available) {
+        profile_.set("numa.system_wide.local_node_pages", after.local_node - before.local_node);
+        profile_.set("numa.system_wide.other_node_pages", after.other_node - before.other_node);
+        profile_.set("numa.system_wide.miss_pages", after.numa_miss - before.numa_miss);
+    }
+}
+
+void BarkerProcessor::runSweep(const std::vector<DonorSelector::Criteria>& criteria, size_t* mapped_indices) {
+    auto sweep_start = std::chrono::steady_clock::now();
+    constructor_.constructSweep(criteria);
+    const auto& indices = constructor_.getSweepIndices();
+    std::copy(indices.begin(), indices.end(), mapped_indices);
+    sweep_criteria_ = criteria;
+    sweep_indices_ = mapped_indices;
+    last_run_ = LastRun::SWEEP;
+    profile_.set("mode", "sweep");
+    profile_.set("timing.construct_seconds", elapsedSeconds(sweep_start));
+}
+
+void BarkerProcessor::write(DatasetWriter& writer) {
+    auto write_start = std::chrono::steady_clock::now();
+    const size_t H_out = outputHeight();
+    const size_t W_out = outputWidth();
+    if (last_run_ == LastRun::SWEEP) {
+        std::vector<double> sweep_parameters;
+        for (const auto& c : sweep_criteria_) {
+            sweep_parameters.push_back(static_cast<double>(c.k_candidates));
+            sweep_parameters.push_back(static_cast<double>(c.max_idx_distance));
+            sweep_parameters.push_back(c.delta_mu0);
+            sweep_parameters.push_back(c.delta_phi0);
+        }
+        writer.writeDataset("mapped_indices", sweep_indices_, {sweep_criteria_.size(), H_out, W_out}, 1);
+        writer.writeDataset("sweep_parameters", sweep_parameters, {sweep_criteria_.size(), 4},
+                            DatasetWriter::REPLICATED);
+        writeGeolocation(writer);
+    } else if (last_run_ == LastRun::CONSTRUCT) {
+        // Each variable is one contiguous plane of the output buffers
+        const size_t K = verticalLevels();
+        writer.writeDataset("mapped_indices", mappedIndices(), {H_out, W_out});
+        for (size_t l = 0; l < profile_variables_.size(); ++l) {
+            writer.writeDataset(profile_variables_[l], profiles() + l * H_out * W_out * K, {H_out, W_out, K});
+        }
+        writeGeolocation(writer);
+        if (surface_) {
+            writeSurface(writer, surface_variables_, surface_, H_out, W_out);
+        }
+    } else {
+        throw std::logic_error("Nothing to write: neither run() nor runSweep() has been called");
+    }
+    profile_.set("timing.write_seconds", elapsedSeconds(write_start));
+}
+
+// Latitude and longitude of the output pixels
+void BarkerProcessor::writeGeolocation(DatasetWriter& writer) const {
+    const size_t H_out = outputHeight();
+    const size_t W_out = outputWidth();
+    std::vector<double> latitude(H_out * W_out);
+    std::vector<double> longitude(H_out * W_out);
+    for (size_t idx = 0; idx < H_out * W_out; ++idx) {
+        latitude[idx]  = msi_.latitude[idx / W_out + i_min_][idx % W_out];
+        longitude[idx] = msi_.longitude[idx / W_out + i_min_][idx % W_out];
+    }
+    writer.writeDataset("latitude", latitude, {H_out, W_out});
+    writer.writeDataset("longitude", longitude, {H_out, W_out});
+}
+
+// Surface fields of the tile's donors, one [H_out][W_out] plane per selected field
+void BarkerProcessor::fillSurface(const Tile& tile, double* surface) const {
+    const size_t NO_DONOR = std::numeric_limits<size_t>::max();
+    const size_t W_out = outputWidth();
+    const size_t plane = mappedIndicesSize();
+    const size_t* indices = constructor_.mappedIndices();
+    for (size_t i = tile.row; i < tile.row + tile.rows; ++i) {
+        for (size_t j = tile.col; j < tile.col + tile.cols; ++j) {
+            size_t pixel = i * W_out + j;
+            size_t ac_idx = indices[pixel];
+            if (ac_idx == NO_DONOR) {
+                for (size_t s = 0; s < surface_ids_.size(); ++s) {
+                    surface[s * plane + pixel] = std::numeric_limits<double>::quiet_NaN();
+                }
+                continue;
+            }
+            size_t aux_idx = ac_idx + options_.aux_offset;
+            if (aux_idx >= aux2d_.longitude.size()) {
+                throw std::out_of_range("AUX index out of range");
+            }
+            CloudConstructor::mapSurface(aux2d_, aux_idx, surface_ids_, surface + pixel, plane);
+        }
+    }
+}
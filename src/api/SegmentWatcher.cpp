@@ -0,0 +1,151 @@
+#include "SegmentWatcher.hpp"
+#include <iostream>
+#include <algorithm>
+#include <filesystem>
+#include <map>
+#include <set>
+#include <thread>
+#include <chrono>
+#include <stdexcept>
+#include "Barker.hpp"
+#include "MSI_RGR_Reader.hpp"
+#include "AC_CLP_Reader.hpp"
+#include "AUX__2D_Reader.hpp"
+
+SegmentWatcher::SegmentWatcher(const std::string& segment_dir, const std::string& output_dir, const Options& options)
+    : segment_dir_(segment_dir),
+      output_dir_(output_dir),
+      options_(options)
+{
+    if (options_.format != "hdf5" && options_.format != "zarr") {
+        throw std::invalid_argument("Unknown output format " + options_.format + " (hdf5, zarr)");
+    }
+    // Same selection as the batch run, in library order
+    BarkerProcessor::selectVariables(options_.variables, profile_ids_, surface_ids_);
+    for (size_t v : profile_ids_) {
+        profile_variables_.push_back(BarkerProcessor::profileVariableNames()[v]);
+    }
+    for (size_t v : surface_ids_) {
+        surface_variables_.push_back(BarkerProcessor::surfaceVariableNames()[v]);
+    }
+}
+
+void SegmentWatcher::writeEmittedRows(DatasetWriter& writer, const IncrementalConstructor::EmittedRows& rows,
+                                      const std::vector<std::string>& profile_variables,
+                                      const std::vector<std::string>& surface_variables) {
+    size_t H_out = rows.num_rows;
+    size_t W_out = rows.width;
+    size_t K = rows.K;
+    writer.writeDataset("mapped_indices", rows.mapped_indices, {H_out, W_out});
+    for (size_t l = 0; l < profile_variables.size(); ++l) {
+        writer.writeDataset(profile_variables[l], rows.mapped_data.data() + l * H_out * W_out * K, {H_out, W_out, K});
+    }
+    writer.writeDataset("latitude", rows.latitude, {H_out, W_out});
+    writer.writeDataset("longitude", rows.longitude, {H_out, W_out});
+    BarkerProcessor::writeSurface(writer, surface_variables, rows.surface.data(), H_out, W_out);
+}
+
+void SegmentWatcher::writeBatch(const IncrementalConstructor::EmittedRows& rows) const {
+    size_t last_row = rows.first_row + rows.num_rows - 1;
+    std::string output_filepath = output_dir_ + "/rows_" + std::to_string(rows.first_row) + "_"
+                                + std::to_string(last_row) + (options_.format == "zarr" ? ".zarr" : ".h5");
+    std::cout << "[SegmentWatcher] Writing rows " << rows.first_row << " - " << last_row
+              << " to: " << output_filepath << std::endl;
+    auto writer = BarkerProcessor::openOutput(output_filepath, options_.format, 1, 0, rows.num_rows);
+    writeEmittedRows(*writer, rows, profile_variables_, surface_variables_);
+}
+
+void SegmentWatcher::run() {
+    namespace fs = std::filesystem;
+    fs::create_directories(output_dir_);
+
+    IncrementalConstructor constructor(
+        [this](const IncrementalConstructor::EmittedRows& rows) { writeBatch(rows); },
+        options_.k_candidates, options_.max_idx_distance, 0, options_.aux_offset);
+    constructor.setAngleThresholds(options_.delta_mu0, options_.delta_phi0);
+    constructor.selectVariables(profile_ids_, surface_ids_);
+
+    auto inProgress = [](const std::string& name) {
+        auto endsWith = [&name](const std::string& suffix) {
+            return name.size() >= suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+        };
+        return name.empty() || name[0] == '.' || endsWith(".tmp") || endsWith(".part");
+    };
+
+    struct FileState {
+        std::uintmax_t size;
+        fs::file_time_type modified;
+        bool operator==(const FileState& other) const { return size == other.size && modified == other.modified; }
+    };
+    std::set<std::string> taken;
+    std::map<std::string, FileState> previous_poll;
+    std::map<std::string, size_t> failed_reads;
+    while (true) {
+        std::vector<std::pair<fs::path, FileState>> files;
+        bool end_of_stream = false;
+        bool writing = false;  // Temporary files still to be renamed into segments
+        for (const auto& entry : fs::directory_iterator(segment_dir_)) {
+            std::error_code error;
+            if (!entry.is_regular_file(error)) continue;
+            std::string name = entry.path().filename().string();
+            if (name == "END") {
+                end_of_stream = true;
+            } else if (inProgress(name)) {
+                writing = true;
+            } else if (!taken.count(name)) {
+                FileState state{entry.file_size(error), entry.last_write_time(error)};
+                if (!error) files.emplace_back(entry.path(), state);
+            }
+        }
+        std::sort(files.begin(), files.end(),
+                  [](const auto& a, const auto& b) { return a.first < b.first; });
+
+        // Segments are appended in name order: stop at the first one not ready yet
+        bool appended = false;
+        std::map<std::string, FileState> this_poll;
+        for (const auto& [file, state] : files) {
+            std::string name = file.filename().string();
+            this_poll[name] = state;
+        }
+        for (const auto& [file, state] : files) {
+            std::string name = file.filename().string();
+            auto previous = previous_poll.find(name);
+            if (previous == previous_poll.end() || !(previous->second == state) || state.size == 0) {
+                break;
+            }
+            try {
+                if (name.find("MSI_RGR") != std::string::npos) {
+                    constructor.appendMSI(MSI_Reader::read(file.string()));
+                } else if (name.find("AC__CLP") != std::string::npos || name.find("AC_CLP") != std::string::npos) {
+                    constructor.appendACCLP(AC_CLP_Reader::read(file.string()));
+                } else if (name.find("AUX") != std::string::npos) {
+                    constructor.appendAUX(AUX__2D_Reader::read(file.string()));
+                } else {
+                    std::cout << "[SegmentWatcher] Ignoring unrecognised file: " << name << std::endl;
+                }
+            } catch (const std::exception& e) {
+                if (++failed_reads[name] >= options_.max_read_attempts) {
+                    throw std::runtime_error("Cannot read segment " + name + " after " +
+                                             std::to_string(options_.max_read_attempts) + " attempts: " + e.what());
+                }
+                std::cout << "[SegmentWatcher] Segment " << name << " not readable yet, retrying: " << e.what()
+                          << std::endl;
+                break;
+            }
+            taken.insert(name);
+            this_poll.erase(name);
+            appended = true;
+        }
+        previous_poll = std::move(this_poll);
+
+        if (end_of_stream && previous_poll.empty() && !writing) {
+            constructor.finish();
+            break;
+        }
+        if (appended) {
+            constructor.process();
+        }
+        std::this_thread::sleep_for(std::chrono::duration<double>(options_.poll_seconds));
+    }
+    std::cout << "[SegmentWatcher] Incremental processing completed successfully" << std::endl;
+}
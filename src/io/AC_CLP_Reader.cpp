@@ -1,8 +1,66 @@
 #include "AC_CLP_Reader.hpp"
+#include "MappedDataset.hpp"
 #include <highfive/H5File.hpp>
 #include <iostream>
+#include <algorithm>
+
+namespace {
+
+// Profile variable -> dataset
+template <typename T>
+struct ProfileField {
+    const char* variable;
+    const char* dataset;
+    ArrayView2D<T> AC_CLP_Data::* field;
+};
+
+const ProfileField<double> kDoubleFields[] = {
+    {"cloud_effective_radius1", "ScienceData/Data/cloud_effective_radius1_1km", &AC_CLP_Data::cloud_effective_radius1},
+    {"cloud_effective_radius2", "ScienceData/Data/cloud_effective_radius2_1km", &AC_CLP_Data::cloud_effective_radius2},
+    {"cloud_water_content1", "ScienceData/Data/cloud_water_content1_1km", &AC_CLP_Data::cloud_water_content1},
+    {"cloud_water_content2", "ScienceData/Data/cloud_water_content2_1km", &AC_CLP_Data::cloud_water_content2},
+    {"height", "ScienceData/Geo/height", &AC_CLP_Data::height},
+};
+
+const ProfileField<int> kIntFields[] = {
+    {"cloud_phase1", "ScienceData/Data/cloud_phase1_1km", &AC_CLP_Data::cloud_phase1},
+    {"cloud_phase2", "ScienceData/Data/cloud_phase2_1km", &AC_CLP_Data::cloud_phase2},
+    {"radar_lidar_flag", "ScienceData/Data/radar_lider_flag_1km", &AC_CLP_Data::radar_lidar_flag},
+};
+
+bool requested(const std::vector<std::string>& variables, const char* name) {
+    return std::find(variables.begin(), variables.end(), name) != variables.end();
+}
+
+template <typename T, size_t N>
+void gatherFields(const HighFive::File& file, const ProfileField<T> (&fields)[N], const std::vector<size_t>& rows,
+                  const std::vector<std::string>& variables, AC_CLP_Data& acclp_data) {
+    for (const auto& f : fields) {
+        acclp_data.*f.field = requested(variables, f.variable)
+                            ? MappedDataset::readRows<T, 2>(file, f.dataset, rows)
+                            : ArrayView2D<T>();
+    }
+}
+
+} // namespace
 
 std::unique_ptr<AC_CLP_Data> AC_CLP_Reader::read(const std::string& filepath) {
+    auto acclp_data = readGeometry(filepath);
+
+    // Science data
+    HighFive::File file(filepath, HighFive::File::ReadOnly);
+    for (const auto& f : kDoubleFields) {
+        acclp_data.get()->*f.field = MappedDataset::read<double, 2>(file, f.dataset);
+    }
+    for (const auto& f : kIntFields) {
+        acclp_data.get()->*f.field = MappedDataset::read<int, 2>(file, f.dataset);
+    }
+    std::cout << "[AC_CLP_Reader] AC_CLP reading completed." << std::endl;
+
+    return acclp_data;
+}
+
+std::unique_ptr<AC_CLP_Data> AC_CLP_Reader::readGeometry(const std::string& filepath) {
     using namespace HighFive;
     std::cout << "[AC_CLP_Reader] Reading file: " << filepath << std::endl;
 
@@ -10,26 +68,24 @@ std::unique_ptr<AC_CLP_Data> AC_CLP_Reader::read(const std::string& filepath) {
     auto acclp_data = std::make_unique<AC_CLP_Data>();
 
     // Coordinates
-    file.getDataSet("ScienceData/Geo/longitude").read(acclp_data->longitude); // [N]
-    file.getDataSet("ScienceData/Geo/latitude").read(acclp_data->latitude);   // [N]
+    acclp_data->longitude = MappedDataset::read<double, 1>(file, "ScienceData/Geo/longitude"); // [N]
+    acclp_data->latitude  = MappedDataset::read<double, 1>(file, "ScienceData/Geo/latitude");  // [N]
     size_t N = acclp_data->longitude.size();
     std::cout << "[AC_CLP_Reader] Geo points: " << N << std::endl;
 
-    // Science data
-    file.getDataSet("ScienceData/Data/cloud_effective_radius1_1km").read(acclp_data->cloud_effective_radius1);
-    file.getDataSet("ScienceData/Data/cloud_effective_radius2_1km").read(acclp_data->cloud_effective_radius2);
-    file.getDataSet("ScienceData/Data/cloud_water_content1_1km").read(acclp_data->cloud_water_content1);
-    file.getDataSet("ScienceData/Data/cloud_water_content2_1km").read(acclp_data->cloud_water_content2);
-    file.getDataSet("ScienceData/Data/cloud_phase1_1km").read(acclp_data->cloud_phase1);
-    file.getDataSet("ScienceData/Data/cloud_phase2_1km").read(acclp_data->cloud_phase2);
-    file.getDataSet("ScienceData/Data/radar_lider_flag_1km").read(acclp_data->radar_lidar_flag);
-    file.getDataSet("ScienceData/Geo/height").read(acclp_data->height);
-    
-    size_t K = acclp_data->height.size();
-    std::cout << "[AC_CLP_Reader] Vertical levels per point: " << K << std::endl;
-    std::cout << "[AC_CLP_Reader] Cloud effective radius1[619][194] : " << acclp_data->cloud_effective_radius1[619][194] << std::endl;
-    std::cout << "[AC_CLP_Reader] Sample height[0][0] : " << acclp_data->height[0][0] << std::endl;
-    std::cout << "[AC_CLP_Reader] AC_CLP reading completed." << std::endl;
+    std::vector<size_t> height_dims = file.getDataSet("ScienceData/Geo/height").getDimensions();
+    acclp_data->vertical_levels = height_dims.size() == 2 ? height_dims[1] : 0;
+    std::cout << "[AC_CLP_Reader] Vertical levels per point: " << acclp_data->vertical_levels << std::endl;
 
     return acclp_data;
 }
+
+void AC_CLP_Reader::readProfiles(const std::string& filepath, const std::vector<size_t>& rows,
+                                 const std::vector<std::string>& variables, AC_CLP_Data& acclp_data) {
+    std::cout << "[AC_CLP_Reader] Gathering " << rows.size() << " profiles from: " << filepath << std::endl;
+
+    HighFive::File file(filepath, HighFive::File::ReadOnly);
+    gatherFields(file, kDoubleFields, rows, variables, acclp_data);
+    gatherFields(file, kIntFields, rows, variables, acclp_data);
+    acclp_data.profile_rows = rows;
+}
@@ -1,8 +1,71 @@
 #include "AUX__2D_Reader.hpp"
+#include "MappedDataset.hpp"
 #include <highfive/H5File.hpp>
 #include <iostream>
+#include <algorithm>
+
+namespace {
+
+// Variable -> dataset
+template <typename View>
+struct AuxField {
+    const char* variable;
+    const char* dataset;
+    View AUX__2D_Data::* field;
+};
+
+const AuxField<ArrayView2D<double>> kProfileFields[] = {
+    {"ozoneMassMixingRatio", "ScienceData/Data/ozoneMassMixingRatio", &AUX__2D_Data::ozoneMassMixingRatio},
+    {"pressure", "ScienceData/Data/pressure", &AUX__2D_Data::pressure},
+    {"specificHumidity", "ScienceData/Data/specificHumidity", &AUX__2D_Data::specificHumidity},
+    {"temperature", "ScienceData/Data/temperature", &AUX__2D_Data::temperature},
+    {"height_aux", "ScienceData/Geo/height", &AUX__2D_Data::height},
+};
+
+const AuxField<ArrayView1D<double>> kSurfaceFields[] = {
+    {"surfacePressure", "ScienceData/Data/surfacePressure", &AUX__2D_Data::surfacePressure},
+    {"totalColumnOzone", "ScienceData/Data/totalColumnOzone", &AUX__2D_Data::totalColumnOzone},
+    {"totalColumnWaterVapor", "ScienceData/Data/totalColumnWaterVapour", &AUX__2D_Data::totalColumnWaterVapor},
+};
+
+const AuxField<ArrayView1D<int>> kFlagFields[] = {
+    {"day_night_flag", "ScienceData/Geo/day_night_flag", &AUX__2D_Data::day_night_flag},
+    {"land_water_flag", "ScienceData/Geo/land_water_flag", &AUX__2D_Data::land_water_flag},
+};
+
+template <typename View, size_t N>
+void readFields(const HighFive::File& file, const AuxField<View> (&fields)[N], AUX__2D_Data& aux2d_data) {
+    for (const auto& f : fields) {
+        aux2d_data.*f.field = MappedDataset::read<typename View::value_type, View::rank>(file, f.dataset);
+    }
+}
+
+template <typename View, size_t N>
+void gatherFields(const HighFive::File& file, const AuxField<View> (&fields)[N], const std::vector<size_t>& rows,
+                  const std::vector<std::string>& variables, AUX__2D_Data& aux2d_data) {
+    for (const auto& f : fields) {
+        bool requested = std::find(variables.begin(), variables.end(), f.variable) != variables.end();
+        aux2d_data.*f.field = requested
+                            ? MappedDataset::readRows<typename View::value_type, View::rank>(file, f.dataset, rows)
+                            : View();
+    }
+}
+
+} // namespace
 
 std::unique_ptr<AUX__2D_Data> AUX__2D_Reader::read(const std::string& filepath) {
+    auto aux2d_data = readGeometry(filepath);
+
+    // Science data
+    HighFive::File file(filepath, HighFive::File::ReadOnly);
+    readFields(file, kProfileFields, *aux2d_data);
+    readFields(file, kSurfaceFields, *aux2d_data);
+    readFields(file, kFlagFields, *aux2d_data);
+
+    return aux2d_data;
+}
+
+std::unique_ptr<AUX__2D_Data> AUX__2D_Reader::readGeometry(const std::string& filepath) {
     using namespace HighFive;
     std::cout << "[AUX__2D_Reader] Reading file: " << filepath << std::endl;
 
@@ -10,22 +73,21 @@ std::unique_ptr<AUX__2D_Data> AUX__2D_Reader::read(const std::string& filepath)
     auto aux2d_data = std::make_unique<AUX__2D_Data>();
 
     // Coordinates
-    file.getDataSet("ScienceData/Geo/longitude").read(aux2d_data->longitude); // [N]
-    file.getDataSet("ScienceData/Geo/latitude").read(aux2d_data->latitude);   // [N]
+    aux2d_data->longitude = MappedDataset::read<double, 1>(file, "ScienceData/Geo/longitude"); // [N]
+    aux2d_data->latitude  = MappedDataset::read<double, 1>(file, "ScienceData/Geo/latitude");  // [N]
     size_t N = aux2d_data->longitude.size();
     std::cout << "[AUX__2D_Reader] Geo points: " << N << std::endl;
 
-    // Science data
-    file.getDataSet("ScienceData/Data/ozoneMassMixingRatio").read(aux2d_data->ozoneMassMixingRatio);
-    file.getDataSet("ScienceData/Data/pressure").read(aux2d_data->pressure);
-    file.getDataSet("ScienceData/Data/specificHumidity").read(aux2d_data->specificHumidity);
-    file.getDataSet("ScienceData/Data/temperature").read(aux2d_data->temperature);
-    file.getDataSet("ScienceData/Data/surfacePressure").read(aux2d_data->surfacePressure);
-    file.getDataSet("ScienceData/Data/totalColumnOzone").read(aux2d_data->totalColumnOzone);
-    file.getDataSet("ScienceData/Data/totalColumnWaterVapour").read(aux2d_data->totalColumnWaterVapor);
-    file.getDataSet("ScienceData/Geo/day_night_flag").read(aux2d_data->day_night_flag);
-    file.getDataSet("ScienceData/Geo/land_water_flag").read(aux2d_data->land_water_flag);
-    file.getDataSet("ScienceData/Geo/height").read(aux2d_data->height);
-
     return aux2d_data;
 }
+
+void AUX__2D_Reader::readProfiles(const std::string& filepath, const std::vector<size_t>& rows,
+                                  const std::vector<std::string>& variables, AUX__2D_Data& aux2d_data) {
+    std::cout << "[AUX__2D_Reader] Gathering " << rows.size() << " profiles from: " << filepath << std::endl;
+
+    HighFive::File file(filepath, HighFive::File::ReadOnly);
+    gatherFields(file, kProfileFields, rows, variables, aux2d_data);
+    gatherFields(file, kSurfaceFields, rows, variables, aux2d_data);
+    gatherFields(file, kFlagFields, rows, variables, aux2d_data);
+    aux2d_data.profile_rows = rows;
+}
@@ -1,30 +1,91 @@
 #include "HDF5Writer.hpp"
-#include <H5Cpp.h>
 #include <stdexcept>
 
 HDF5_Writer::HDF5_Writer(const std::string& filepath)
-    : file_(filepath, H5F_ACC_TRUNC) {}
-
-void HDF5_Writer::writeDataset(const std::string& name,
-                               const std::vector<size_t>& data,
-                               const std::vector<size_t>& shape) {
-    H5::DataSpace dataspace(shape.size(), reinterpret_cast<const hsize_t*>(shape.data()));
-    H5::DataSet dataset = file_.createDataSet(name, H5::PredType::NATIVE_ULLONG, dataspace);
-    dataset.write(data.data(), H5::PredType::NATIVE_ULLONG);
+    : file_(filepath, HighFive::File::Truncate) {}
+
+#ifdef BARKER_USE_MPI
+namespace {
+
+HighFive::FileAccessProps sharedFileAccess(MPI_Comm comm) {
+    HighFive::FileAccessProps fapl;
+    fapl.add(HighFive::MPIOFileAccess(comm, MPI_INFO_NULL));
+    fapl.add(HighFive::MPIOCollectiveMetadata());
+    return fapl;
+}
+
+int commRank(MPI_Comm comm) {
+    int rank = 0;
+    MPI_Comm_rank(comm, &rank);
+    return rank;
+}
+
+} // namespace
+
+HDF5_Writer::HDF5_Writer(const std::string& filepath, MPI_Comm comm, size_t row_offset, size_t total_rows)
+    : file_(filepath, HighFive::File::Truncate, sharedFileAccess(comm)),
+      shared_(true),
+      rank_(commRank(comm)),
+      row_offset_(row_offset),
+      total_rows_(total_rows) {}
+#endif
+
+void HDF5_Writer::writeDataset(const std::string& name, const size_t* data,
+                               const std::vector<size_t>& shape, size_t row_dim) {
+    write(name, data, shape, row_dim);
+}
+
+void HDF5_Writer::writeDataset(const std::string& name, const double* data,
+                               const std::vector<size_t>& shape, size_t row_dim) {
+    write(name, data, shape, row_dim);
 }
 
-void HDF5_Writer::writeDataset(const std::string& name,
-                               const std::vector<double>& data,
-                               const std::vector<size_t>& shape) {
-    H5::DataSpace dataspace(shape.size(), reinterpret_cast<const hsize_t*>(shape.data()));
-    H5::DataSet dataset = file_.createDataSet(name, H5::PredType::NATIVE_DOUBLE, dataspace);
-    dataset.write(data.data(), H5::PredType::NATIVE_DOUBLE);
+void HDF5_Writer::writeDataset(const std::string& name, const int* data,
+                               const std::vector<size_t>& shape, size_t row_dim) {
+    write(name, data, shape, row_dim);
 }
 
-void HDF5_Writer::writeDataset(const std::string& name,
-                               const std::vector<int>& data,
-                               const std::vector<size_t>& shape) {
-    H5::DataSpace dataspace(shape.size(), reinterpret_cast<const hsize_t*>(shape.data()));
-    H5::DataSet dataset = file_.createDataSet(name, H5::PredType::NATIVE_INT, dataspace);
-    dataset.write(data.data(), H5::PredType::NATIVE_INT);
+template <typename T>
+void HDF5_Writer::write(const std::string& name, const T* data,
+                        const std::vector<size_t>& shape, size_t row_dim) {
+    size_t num_elements = 1;
+    for (size_t d : shape) num_elements *= d;
+
+    if (!shared_) {
+        file_.createDataSet<T>(name, HighFive::DataSpace(shape)).write_raw(data);
+        return;
+    }
+
+#ifdef BARKER_USE_MPI
+    if (row_dim != REPLICATED && row_dim >= shape.size()) {
+        throw std::invalid_argument("Dataset " + name + ": row dimension out of range");
+    }
+
+    // Dataset creation is collective: every rank passes the global shape
+    std::vector<size_t> dims = shape;
+    if (row_dim != REPLICATED) {
+        dims[row_dim] = total_rows_;
+    }
+    HighFive::DataSet dataset = file_.createDataSet<T>(name, HighFive::DataSpace(dims));
+
+    // Every rank takes part in the collective write, possibly with an empty selection;
+    // replicated datasets are written by rank 0 only
+    HighFive::DataTransferProps xfer;
+    xfer.add(HighFive::UseCollectiveIO());
+    bool contributes = num_elements > 0 && (row_dim != REPLICATED || rank_ == 0);
+    if (!contributes) {
+        T unused{};
+        dataset.select(HighFive::HyperSlab(), HighFive::DataSpace(std::vector<size_t>{0}))
+               .write_raw(&unused, xfer);
+        return;
+    }
+    std::vector<size_t> offset(dims.size(), 0);
+    if (row_dim != REPLICATED) {
+        offset[row_dim] = row_offset_;
+    }
+    dataset.select(offset, shape).write_raw(data, xfer);
+#else
+    (void)row_dim;
+    (void)num_elements;
+#endif
 }
@@ -0,0 +1,88 @@
+#include "MappedDataset.hpp"
+#include <hdf5.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdlib>
+
+namespace {
+
+// Keeps a read-only file mapping alive
+struct FileMapping {
+    void* address = MAP_FAILED;
+    size_t length = 0;
+
+    ~FileMapping() {
+        if (address != MAP_FAILED) {
+            munmap(address, length);
+        }
+    }
+};
+
+} // namespace
+
+bool MappedDataset::enabled() {
+    // Decided once; a function-local static is initialised thread-safely
+    static const bool mapping = std::getenv("BARKER_NO_MMAP") == nullptr;
+    return mapping;
+}
+
+bool MappedDataset::contiguousOffset(const HighFive::DataSet& dataset, const HighFive::DataType& mem_type,
+                                     size_t element_size, size_t alignment, uint64_t& offset) {
+    hid_t dset = dataset.getId();
+
+    hid_t dcpl = H5Dget_create_plist(dset);
+    if (dcpl < 0) {
+        return false;
+    }
+    bool plain = H5Pget_layout(dcpl) == H5D_CONTIGUOUS &&
+                 H5Pget_nfilters(dcpl) == 0 &&
+                 H5Pget_external_count(dcpl) == 0;
+    H5Pclose(dcpl);
+    if (!plain) {
+        return false;
+    }
+
+    // The bytes on disk must already be the in-memory representation
+    hid_t file_type = H5Dget_type(dset);
+    bool native = H5Tequal(file_type, mem_type.getId()) > 0 && H5Tget_size(file_type) == element_size;
+    H5Tclose(file_type);
+    if (!native) {
+        return false;
+    }
+
+    haddr_t address = H5Dget_offset(dset);
+    if (address == HADDR_UNDEF || address % alignment != 0) {
+        return false;
+    }
+    offset = static_cast<uint64_t>(address);
+    return true;
+}
+
+std::shared_ptr<const void> MappedDataset::mapRegion(const std::string& filepath, uint64_t offset,
+                                                     size_t length, const void*& data) {
+    int fd = open(filepath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || offset + length > static_cast<uint64_t>(st.st_size)) {
+        close(fd);
+        return nullptr;
+    }
+
+    // mmap offsets must be page aligned
+    uint64_t page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    uint64_t aligned_offset = offset - offset % page;
+    auto mapping = std::make_shared<FileMapping>();
+    mapping->length = length + (offset - aligned_offset);
+    mapping->address = mmap(nullptr, mapping->length, PROT_READ, MAP_PRIVATE, fd, static_cast<off_t>(aligned_offset));
+    close(fd);
+    if (mapping->address == MAP_FAILED) {
+        return nullptr;
+    }
+
+    data = static_cast<const char*>(mapping->address) + (offset - aligned_offset);
+    return mapping;
+}
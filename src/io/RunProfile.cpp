@@ -0,0 +1,25 @@
+#include "RunProfile.hpp"
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+void RunProfile::set(const std::string& key, const std::string& value) {
+    for (auto& entry : entries_) {
+        if (entry.first == key) {
+            entry.second = value;
+            return;
+        }
+    }
+    entries_.emplace_back(key, value);
+}
+
+void RunProfile::write(const std::string& filepath) const {
+    std::ofstream out(filepath);
+    if (!out) {
+        throw std::runtime_error("Cannot write run profile: " + filepath);
+    }
+    for (const auto& entry : entries_) {
+        out << entry.first << " = " << entry.second << "\n";
+    }
+    std::cout << "[RunProfile] Written to: " << filepath << std::endl;
+}
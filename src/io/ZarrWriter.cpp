@@ -0,0 +1,186 @@
+#include "ZarrWriter.hpp"
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <algorithm>
+#include <limits>
+#include <cstring>
+#include <zlib.h>
+#include "WorkerPool.hpp"
+
+namespace {
+
+namespace fs = std::filesystem;
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+const char* kByteOrder = ">";
+#else
+const char* kByteOrder = "<";
+#endif
+
+std::string jsonList(const std::vector<size_t>& values) {
+    std::ostringstream text;
+    text << "[";
+    for (size_t d = 0; d < values.size(); ++d) {
+        text << (d ? ", " : "") << values[d];
+    }
+    text << "]";
+    return text.str();
+}
+
+void writeFile(const fs::path& path, const std::string& content) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << content;
+    if (!out) {
+        throw std::runtime_error("Cannot write " + path.string());
+    }
+}
+
+} // namespace
+
+Zarr_Writer::Zarr_Writer(const std::string& path, size_t threads, int compression_level,
+                         size_t chunk_rows, size_t chunk_cols)
+    : path_(path),
+      threads_(std::max<size_t>(threads, 1)),
+      compression_level_(compression_level),
+      chunk_rows_(std::max<size_t>(chunk_rows, 1)),
+      chunk_cols_(std::max<size_t>(chunk_cols, 1)) {
+    // Only a previous Zarr store is replaced, never an unrelated directory
+    if (fs::exists(path_)) {
+        if (fs::is_directory(path_) && fs::exists(fs::path(path_) / ".zgroup")) {
+            fs::remove_all(path_);
+        } else if (!fs::is_directory(path_) || !fs::is_empty(path_)) {
+            throw std::runtime_error(path_ + " exists and is not a Zarr store");
+        }
+    }
+    fs::create_directories(path_);
+    writeFile(fs::path(path_) / ".zgroup", "{\n    \"zarr_format\": 2\n}\n");
+}
+
+void Zarr_Writer::writeDataset(const std::string& name, const size_t* data,
+                               const std::vector<size_t>& shape, size_t row_dim) {
+    static_assert(sizeof(size_t) == 8, "size_t datasets are stored as u8");
+    write(name, data, shape, row_dim, std::string(kByteOrder) + "u8", "18446744073709551615",
+          std::numeric_limits<size_t>::max());
+}
+
+void Zarr_Writer::writeDataset(const std::string& name, const double* data,
+                               const std::vector<size_t>& shape, size_t row_dim) {
+    write(name, data, shape, row_dim, std::string(kByteOrder) + "f8", "\"NaN\"",
+          std::numeric_limits<double>::quiet_NaN());
+}
+
+void Zarr_Writer::writeDataset(const std::string& name, const int* data,
+                               const std::vector<size_t>& shape, size_t row_dim) {
+    static_assert(sizeof(int) == 4, "int datasets are stored as i4");
+    write(name, data, shape, row_dim, std::string(kByteOrder) + "i4", "0", 0);
+}
+
+std::vector<size_t> Zarr_Writer::chunkShape(const std::vector<size_t>& shape, size_t row_dim) const {
+    std::vector<size_t> chunks(shape);
+    if (row_dim != REPLICATED && row_dim < shape.size()) {
+        for (size_t d = 0; d < row_dim; ++d) {
+            chunks[d] = 1;
+        }
+        chunks[row_dim] = std::min(chunk_rows_, shape[row_dim]);
+        if (row_dim + 1 < shape.size()) {
+            chunks[row_dim + 1] = std::min(chunk_cols_, shape[row_dim + 1]);
+        }
+    }
+    // Zarr chunks are at least 1 along every dimension, also for zero-extent arrays
+    for (size_t& c : chunks) c = std::max<size_t>(c, 1);
+    return chunks;
+}
+
+template <typename T>
+void Zarr_Writer::write(const std::string& name, const T* data, const std::vector<size_t>& shape,
+                        size_t row_dim, const std::string& dtype, const std::string& fill_value, T fill) {
+    const size_t rank = shape.size();
+    if (rank == 0) {
+        throw std::invalid_argument("Dataset " + name + ": scalar datasets are not supported");
+    }
+    const std::vector<size_t> chunks = chunkShape(shape, row_dim);
+    fs::path array_dir = fs::path(path_) / name;
+    fs::create_directories(array_dir);
+    writeFile(array_dir / ".zarray",
+              "{\n"
+              "    \"chunks\": " + jsonList(chunks) + ",\n"
+              "    \"compressor\": {\n"
+              "        \"id\": \"zlib\",\n"
+              "        \"level\": " + std::to_string(compression_level_) + "\n"
+              "    },\n"
+              "    \"dtype\": \"" + dtype + "\",\n"
+              "    \"fill_value\": " + fill_value + ",\n"
+              "    \"filters\": null,\n"
+              "    \"order\": \"C\",\n"
+              "    \"shape\": " + jsonList(shape) + ",\n"
+              "    \"zarr_format\": 2\n"
+              "}\n");
+    writeFile(array_dir / ".zattrs", "{}\n");
+
+    // Chunk grid, chunk c has grid coordinates grid_index[d] in row-major order
+    std::vector<size_t> grid(rank);
+    size_t num_chunks = 1;
+    size_t chunk_elements = 1;
+    for (size_t d = 0; d < rank; ++d) {
+        grid[d] = (shape[d] + chunks[d] - 1) / chunks[d];
+        num_chunks *= grid[d];
+        chunk_elements *= chunks[d];
+    }
+    std::vector<size_t> strides(rank, 1);
+    for (size_t d = rank; d-- > 1;) {
+        strides[d - 1] = strides[d] * shape[d];
+    }
+
+    // Scratch buffers of each worker, allocated by the worker itself
+    struct Scratch {
+        std::vector<T> buffer;
+        std::vector<Bytef> compressed;
+        std::vector<size_t> grid_index;
+    };
+    std::vector<Scratch> scratch(WorkerPool::workers(num_chunks, threads_));
+    WorkerPool::run(num_chunks, threads_,
+        [&](size_t worker) {
+            scratch[worker].buffer.resize(chunk_elements);
+            scratch[worker].compressed.resize(compressBound(chunk_elements * sizeof(T)));
+            scratch[worker].grid_index.resize(rank);
+        },
+        [&](size_t c, size_t worker) {
+            auto& [buffer, compressed, grid_index] = scratch[worker];
+            std::string key;
+            for (size_t d = rank, rest = c; d-- > 0;) {
+                grid_index[d] = rest % grid[d];
+                rest /= grid[d];
+            }
+            for (size_t d = 0; d < rank; ++d) {
+                key += (d ? "." : "") + std::to_string(grid_index[d]);
+            }
+
+            // Gather the chunk, innermost dimension as contiguous runs
+            std::fill(buffer.begin(), buffer.end(), fill);
+            size_t inner = rank - 1;
+            size_t run = std::min(chunks[inner], shape[inner] - grid_index[inner] * chunks[inner]);
+            size_t num_runs = chunk_elements / chunks[inner];
+            for (size_t r = 0; r < num_runs; ++r) {
+                size_t src = grid_index[inner] * chunks[inner];
+                bool inside = true;
+                for (size_t d = inner, rest = r; d-- > 0;) {
+                    size_t local = rest % chunks[d];
+                    rest /= chunks[d];
+                    size_t global = grid_index[d] * chunks[d] + local;
+                    inside = inside && global < shape[d];
+                    src += global * strides[d];
+                }
+                if (inside) {
+                    std::memcpy(&buffer[r * chunks[inner]], data + src, run * sizeof(T));
+                }
+            }
+
+            uLongf length = compressed.size();
+            if (compress2(compressed.data(), &length, reinterpret_cast<const Bytef*>(buffer.data()),
+                          buffer.size() * sizeof(T), compression_level_) != Z_OK) {
+                throw std::runtime_error("Dataset " + name + ": zlib compression failed");
+            }
+            writeFile(array_dir / key, std::string(reinterpret_cast<const char*>(compressed.data()), length));
+        });
+}
@@ -0,0 +1,259 @@
+#include "Autotuner.hpp"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <thread>
+#include <limits>
+#include <cstdlib>
+#include <filesystem>
+#include <unistd.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Best of two runs, the first one also warms the caches
+double timeSample(const CloudConstructor& constructor, size_t i_begin, size_t i_end, std::vector<size_t>& donors) {
+    double best = std::numeric_limits<double>::infinity();
+    for (int repeat = 0; repeat < 2; ++repeat) {
+        auto start = Clock::now();
+        donors = constructor.searchRows(i_begin, i_end);
+        best = std::min(best, secondsSince(start));
+    }
+    return best;
+}
+
+size_t log2Ceil(size_t n) {
+    size_t bits = 0;
+    while ((size_t(1) << bits) < n) ++bits;
+    return bits;
+}
+
+std::string describe(const CloudConstructor::SearchOptions& o) {
+    std::ostringstream text;
+    text << (o.brute_force ? "brute" : "kd") << " leaf " << o.leaf_size
+         << ", tile " << o.tile_size << ", threads " << o.threads;
+    return text.str();
+}
+
+} // namespace
+
+Autotuner::Autotuner(std::string cache_path, size_t sample_pixels, size_t max_threads)
+    : cache_path_(std::move(cache_path)),
+      sample_pixels_(std::max<size_t>(sample_pixels, 1)),
+      max_threads_(max_threads ? max_threads : std::max(1u, std::thread::hardware_concurrency())) {}
+
+std::string Autotuner::shapeClass(size_t num_pixels, size_t num_acclp_points, size_t k_candidates) {
+    std::ostringstream text;
+    text << "pixels:2^" << log2Ceil(num_pixels)
+         << "/acclp:2^" << log2Ceil(num_acclp_points)
+         << "/k:2^" << log2Ceil(k_candidates);
+    return text.str();
+}
+
+std::string Autotuner::hostName() {
+    char name[256] = {};
+    if (gethostname(name, sizeof(name) - 1) != 0 || name[0] == '\0') {
+        return "unknown";
+    }
+    return name;
+}
+
+std::string Autotuner::defaultCachePath() {
+    if (const char* path = std::getenv("BARKER_AUTOTUNE_CACHE")) {
+        return path;
+    }
+    if (const char* home = std::getenv("HOME")) {
+        return std::string(home) + "/.cache/barker-autotune.txt";
+    }
+    return "barker-autotune.txt";
+}
+
+Autotuner::Result Autotuner::tune(CloudConstructor& constructor, size_t num_acclp_points, size_t k_candidates) const {
+    Result result;
+    size_t H_out = constructor.outputHeight();
+    size_t W_out = constructor.outputWidth();
+    result.host = hostName();
+    result.shape_class = shapeClass(H_out * W_out, num_acclp_points, k_candidates);
+    // NUMA placement is not tuned, every candidate keeps the constructor's
+    const CloudConstructor::SearchOptions placement = constructor.searchOptions();
+    result.options.pinning = placement.pinning;
+    result.options.numa_replicas = placement.numa_replicas;
+
+    CloudConstructor::SearchOptions best = CloudConstructor::SearchOptions();
+    best.pinning = placement.pinning;
+    best.numa_replicas = placement.numa_replicas;
+
+    // Band of about the given number of pixels in the middle of the frame
+    auto middleRows = [H_out, W_out](size_t pixels) {
+        size_t rows = std::min(H_out, std::max<size_t>((pixels + W_out - 1) / std::max<size_t>(W_out, 1), 1));
+        size_t begin = (H_out - rows) / 2;
+        return std::make_pair(begin, begin + rows);
+    };
+
+    // A cached choice was exact on another frame of the same class; it is used only
+    // if it still gives the default configuration's donors on a smaller band of this one
+    if (loadCached(result.host, result.shape_class, result.options)) {
+        auto rows = middleRows(sample_pixels_ / 8);
+        constructor.setSearchOptions(best);
+        std::vector<size_t> reference = constructor.searchRows(rows.first, rows.second);
+        constructor.setSearchOptions(result.options);
+        if (constructor.searchRows(rows.first, rows.second) == reference) {
+            std::cout << "[Autotuner] Cached for " << result.shape_class << ": " << describe(result.options) << std::endl;
+            result.from_cache = true;
+            return result;
+        }
+        std::cout << "[Autotuner] Cached " << describe(result.options) << ": donors differ on rows " << rows.first
+                  << " - " << rows.second - 1 << ", tuning again" << std::endl;
+    }
+
+    auto rows = middleRows(sample_pixels_);
+    size_t i_begin = rows.first;
+    size_t i_end = rows.second;
+    double scale = static_cast<double>(H_out) / (i_end - i_begin);
+    std::cout << "[Autotuner] Timing rows " << i_begin << " - " << i_end - 1 << " for " << result.shape_class << std::endl;
+
+    constructor.setSearchOptions(best);
+    std::vector<size_t> reference;
+    double best_seconds = timeSample(constructor, i_begin, i_end, reference) * scale;
+    result.candidates_timed = 1;
+
+    // Estimated full-frame time of a candidate (index rebuild + scaled sample), infinity if not exact
+    auto evaluate = [&](const CloudConstructor::SearchOptions& candidate) {
+        auto start = Clock::now();
+        constructor.setSearchOptions(candidate);
+        double build_seconds = secondsSince(start);
+        std::vector<size_t> donors;
+        double seconds = build_seconds + timeSample(constructor, i_begin, i_end, donors) * scale;
+        ++result.candidates_timed;
+        if (donors != reference) {
+            std::cout << "[Autotuner] " << describe(candidate) << ": donors differ, rejected" << std::endl;
+            return std::numeric_limits<double>::infinity();
+        }
+        std::cout << "[Autotuner] " << describe(candidate) << ": " << seconds << " s (estimated)" << std::endl;
+        return seconds;
+    };
+
+    // Search engine
+    std::vector<CloudConstructor::SearchOptions> engines;
+    for (size_t leaf : {4, 8, 16, 32, 64}) {
+        CloudConstructor::SearchOptions o = best;
+        o.leaf_size = leaf;
+        engines.push_back(o);
+    }
+    CloudConstructor::SearchOptions brute = best;
+    brute.brute_force = true;
+    engines.push_back(brute);
+    CloudConstructor::SearchOptions engine_best = best;
+    for (const auto& candidate : engines) {
+        double seconds = evaluate(candidate);
+        if (seconds < best_seconds) {
+            best_seconds = seconds;
+            engine_best = candidate;
+        }
+    }
+    best = engine_best;
+
+    // Threads x tile size, with the chosen engine (no rebuild)
+    std::vector<size_t> thread_counts;
+    for (size_t t = 1; t < max_threads_; t *= 2) thread_counts.push_back(t);
+    thread_counts.push_back(max_threads_);
+    CloudConstructor::SearchOptions layout_best = best;
+    best_seconds = std::numeric_limits<double>::infinity();
+    for (size_t threads : thread_counts) {
+        for (size_t tile : {8, 16, 32, 64}) {
+            CloudConstructor::SearchOptions candidate = best;
+            candidate.threads = threads;
+            candidate.tile_size = tile;
+            double seconds = evaluate(candidate);
+            if (seconds < best_seconds) {
+                best_seconds = seconds;
+                layout_best = candidate;
+            }
+        }
+    }
+    best = layout_best;
+
+    constructor.setSearchOptions(best);
+    result.options = best;
+    result.pixels_per_second = (H_out * W_out) / best_seconds;
+    std::cout << "[Autotuner] Chose " << describe(best) << " after " << result.candidates_timed << " candidates" << std::endl;
+    storeCached(result.host, result.shape_class, best);
+    return result;
+}
+
+// Cache lines: <host> <shape_class> <kd|brute> <leaf_size> <tile_size> <threads>
+bool Autotuner::loadCached(const std::string& host, const std::string& shape_class,
+                           CloudConstructor::SearchOptions& options) const {
+    if (cache_path_.empty()) return false;
+    std::ifstream in(cache_path_);
+    std::string line;
+    bool found = false;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream fields(line);
+        std::string entry_host, entry_shape, engine;
+        CloudConstructor::SearchOptions entry = options;
+        // Entries with more threads than allowed now are tuned again
+        if (fields >> entry_host >> entry_shape >> engine >> entry.leaf_size >> entry.tile_size >> entry.threads &&
+            entry_host == host && entry_shape == shape_class && entry.threads <= max_threads_) {
+            entry.brute_force = (engine == "brute");
+            options = entry;
+            found = true;
+        }
+    }
+    return found;
+}
+
+void Autotuner::storeCached(const std::string& host, const std::string& shape_class,
+                            const CloudConstructor::SearchOptions& options) const {
+    if (cache_path_.empty()) return;
+    std::vector<std::string> lines;
+    {
+        std::ifstream in(cache_path_);
+        std::string line;
+        while (std::getline(in, line)) {
+            std::istringstream fields(line);
+            std::string entry_host, entry_shape;
+            fields >> entry_host >> entry_shape;
+            if (line.empty() || line[0] == '#' || entry_host != host || entry_shape != shape_class) {
+                lines.push_back(line);
+            }
+        }
+    }
+    std::filesystem::path parent = std::filesystem::path(cache_path_).parent_path();
+    std::error_code error;
+    if (!parent.empty()) {
+        std::filesystem::create_directories(parent, error);
+    }
+    // Written to a private temporary file and renamed over the cache, so concurrent
+    // runs never read a partly written cache (the last writer's entries win)
+    std::string temp_path = cache_path_ + ".tmp." + hostName() + "." + std::to_string(getpid());
+    {
+        std::ofstream out(temp_path, std::ios::trunc);
+        if (lines.empty() || lines.front().rfind("#", 0) != 0) {
+            out << "# host shape_class engine leaf_size tile_size threads\n";
+        }
+        for (const auto& line : lines) {
+            out << line << "\n";
+        }
+        out << host << " " << shape_class << " " << (options.brute_force ? "brute" : "kd") << " "
+            << options.leaf_size << " " << options.tile_size << " " << options.threads << "\n";
+        out.close();
+        if (!out) {
+            std::cerr << "[Autotuner] Cannot write cache: " << temp_path << std::endl;
+            std::filesystem::remove(temp_path, error);
+            return;
+        }
+    }
+    std::filesystem::rename(temp_path, cache_path_, error);
+    if (error) {
+        std::cerr << "[Autotuner] Cannot replace cache " << cache_path_ << ": " << error.message() << std::endl;
+        std::filesystem::remove(temp_path, error);
+    }
+}
@@ -1,6 +1,28 @@
 #include "CloudConstructor.hpp"
+#include "WorkerPool.hpp"
 #include <iostream>
 #include <cmath>
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+namespace {
+
+// Per-pixel AUX surface fields of the donor, in output order
+enum SurfaceVariable {
+    SURFACE_PRESSURE,
+    TOTAL_COLUMN_OZONE,
+    TOTAL_COLUMN_WATER_VAPOR,
+    DAY_NIGHT_FLAG,
+    LAND_WATER_FLAG
+};
+
+template <typename T>
+double surfaceValue(const ArrayView1D<T>& field, size_t row) {
+    return field.empty() ? std::numeric_limits<double>::quiet_NaN() : static_cast<double>(field[row]);
+}
+
+} // namespace
 
 CloudConstructor::CloudConstructor(const MSI_RGR_Data* msi_data,
                                    AC_CLP_Data* acclp_data,
@@ -22,7 +44,7 @@ CloudConstructor::CloudConstructor(const MSI_RGR_Data* msi_data,
       donor_selector_(msi_data, acclp_data, {}, k_candidates, max_idx_distance,
                       AC_LogSpectralKDTree_, AC_CoordKDTree_, MSI_CoordKDTree_),
       H_(msi_data->longitude.size()),
-      W_(msi_data->longitude[0].size()),
+      W_(msi_data->width()),
       K_(num_vertical_levels),
       L_(num_variables),
       H_out_(i_max - i_min + 1),
@@ -45,7 +67,7 @@ CloudConstructor::CloudConstructor(const MSI_RGR_Data* msi_data,
 
     // Copy nearest MSI radiance data to AC //
     size_t num_ac_points = acclp_->longitude.size();
-    size_t num_bands = msi_->radiance[0][0].size();
+    size_t num_bands = msi_->bands();
     acclp_->radiance.resize(num_ac_points);
 
     for (size_t i = 0; i < num_ac_points; ++i) {
@@ -61,7 +83,7 @@ CloudConstructor::CloudConstructor(const MSI_RGR_Data* msi_data,
 
         KDTreeSearcherBand::Spectrum spectrum;
         for (size_t b = 0; b < num_bands; ++b) {
-            spectrum[b] = std::log(msi_->radiance[msi_i][msi_j][b]);
+            spectrum[b] = std::log(msi_->radianceAt(msi_i, msi_j, b));
         }
         acclp_->radiance[i] = spectrum;
     }
@@ -76,57 +98,607 @@ CloudConstructor::CloudConstructor(const MSI_RGR_Data* msi_data,
     }
     AC_CoordKDTree_.setData(acclp_coords);
 
-    // Initialize mapped indices and data structures
-    // mapped_indices_.assign(H_ * W_, 0);
-    // mapped_data_.assign(H_ * W_ * K_ * L_, std::numeric_limits<double>::quiet_NaN());
-    mapped_indices_.assign(H_out_ * W_out_, 0);
-    mapped_data_.assign(H_out_ * W_out_ * K_ * L_, std::numeric_limits<double>::quiet_NaN());
+    // Left unfilled: each tile's pages are first touched by the worker searching it
+    mapped_indices_.resize(H_out_ * W_out_);
+    indices_out_ = mapped_indices_.data();
+    std::vector<size_t> variables(std::min(L_, NUM_PROFILE_VARIABLES));
+    for (size_t l = 0; l < variables.size(); ++l) {
+        variables[l] = l;
+    }
+    selectVariables(variables);
+}
+
+const std::vector<std::string>& CloudConstructor::profileVariableNames() {
+    static const std::vector<std::string> names = {
+        "cloud_effective_radius1",
+        "cloud_effective_radius2",
+        "cloud_water_content1",
+        "cloud_water_content2",
+        "cloud_phase1",
+        "cloud_phase2",
+        "radar_lidar_flag",
+        "height",
+        "ozoneMassMixingRatio",
+        "pressure",
+        "specificHumidity",
+        "temperature",
+        "height_aux"
+    };
+    return names;
+}
+
+const std::vector<std::string>& CloudConstructor::surfaceVariableNames() {
+    static const std::vector<std::string> names = {
+        "surfacePressure",
+        "totalColumnOzone",
+        "totalColumnWaterVapor",
+        "day_night_flag",
+        "land_water_flag"
+    };
+    return names;
+}
+
+void CloudConstructor::selectVariables(const std::vector<size_t>& variables) {
+    for (size_t v : variables) {
+        if (v >= NUM_PROFILE_VARIABLES) {
+            throw std::out_of_range("Profile variable index out of range: " + std::to_string(v));
+        }
+    }
+    variables_ = variables;
+    L_ = variables_.size();
+    if (!external_data_) {
+        // Left unfilled: each tile's pages are first touched by the worker mapping it
+        mapped_data_.clear();
+        mapped_data_.resize(H_out_ * W_out_ * K_ * L_);
+        data_out_ = mapped_data_.data();
+    }
+}
+
+void CloudConstructor::setOutputBuffers(size_t* mapped_indices, double* mapped_data) {
+    if (mapped_indices) {
+        mapped_indices_.clear();
+        mapped_indices_.shrink_to_fit();
+        indices_out_ = mapped_indices;
+    } else {
+        mapped_indices_.resize(H_out_ * W_out_);
+        indices_out_ = mapped_indices_.data();
+    }
+    external_data_ = mapped_data != nullptr;
+    if (external_data_) {
+        mapped_data_.clear();
+        mapped_data_.shrink_to_fit();
+        data_out_ = mapped_data;
+    } else {
+        // Left unfilled: each tile's pages are first touched by the worker mapping it
+        mapped_data_.clear();
+        mapped_data_.resize(H_out_ * W_out_ * K_ * L_);
+        data_out_ = mapped_data_.data();
+    }
 }
 
 void CloudConstructor::construct() {
-    std::cout << "[CloudConstructor] Starting cloud construction" << std::endl;
+    std::cout << "[CloudConstructor] Starting cloud construction (threads: " << search_options_.threads
+              << ", tile size: " << search_options_.tile_size << ")" << std::endl;
+
+    if (profile_loader_) {
+        // Profiles can only be loaded once every donor is known
+        forEachTile(0, H_out_, [this](const Tile& tile) { searchTile(tile, 0, indices_out_); });
+        mapVariables();
+    } else {
+        forEachTile(0, H_out_, [this](const Tile& tile) {
+            searchTile(tile, 0, indices_out_);
+            mapTile(tile);
+            if (tile_callback_) tile_callback_(tile);
+        });
+    }
+    std::cout << "[CloudConstructor] Cloud construction completed successfully" << std::endl;
+}
+
+void CloudConstructor::setSearchOptions(const SearchOptions& options) {
+    bool rebuild = options.leaf_size != search_options_.leaf_size;
+    if (rebuild) {
+        AC_LogSpectralKDTree_.setLeafSize(options.leaf_size);
+        AC_CoordKDTree_.setLeafSize(options.leaf_size);
+        MSI_CoordKDTree_.setLeafSize(options.leaf_size);
+    }
+    AC_LogSpectralKDTree_.setBruteForce(options.brute_force);
+    search_options_ = options;
+
+    if (!options.numa_replicas) {
+        replicas_.clear();
+    } else if (rebuild || replicas_.empty()) {
+        buildReplicas();
+    } else {
+        for (auto& replica : replicas_) {
+            replica->AC_LogSpectralKDTree.setBruteForce(options.brute_force);
+        }
+    }
+}
+
+// One copy of the kd-trees per NUMA node, built by a thread running on that
+// node so that its pages are allocated there
+void CloudConstructor::buildReplicas() {
+    const NumaTopology& topology = NumaTopology::system();
+    replicas_.clear();
+    replicas_.resize(topology.numNodes());
+    std::vector<std::thread> builders;
+    for (size_t node = 0; node < topology.numNodes(); ++node) {
+        builders.emplace_back([this, &topology, node]() {
+            NumaTopology::pinCurrentThread(topology.cpus(node));
+            auto replica = std::make_unique<SearchReplica>();
+            replica->AC_LogSpectralKDTree.setLeafSize(search_options_.leaf_size);
+            replica->AC_LogSpectralKDTree.setBruteForce(search_options_.brute_force);
+            replica->AC_LogSpectralKDTree.setData(AC_LogSpectralKDTree_.points());
+            replica->AC_CoordKDTree.setLeafSize(search_options_.leaf_size);
+            replica->AC_CoordKDTree.setData(AC_CoordKDTree_.points());
+            replica->MSI_CoordKDTree.setLeafSize(search_options_.leaf_size);
+            replica->MSI_CoordKDTree.setData(MSI_CoordKDTree_.points());
+            replica->selector = std::make_unique<DonorSelector>(
+                msi_, acclp_, std::vector<double>{}, k_candidates_, max_idx_distance_,
+                replica->AC_LogSpectralKDTree, replica->AC_CoordKDTree, replica->MSI_CoordKDTree);
+            replica->selector->setAngleThresholds(donor_selector_.deltaMu0(), donor_selector_.deltaPhi0());
+            replicas_[node] = std::move(replica);
+        });
+    }
+    for (auto& builder : builders) {
+        builder.join();
+    }
+    std::cout << "[CloudConstructor] Built kd-tree replicas on " << replicas_.size() << " NUMA node(s)" << std::endl;
+}
+
+std::vector<size_t> CloudConstructor::searchRows(size_t i_begin, size_t i_end) const {
+    std::vector<size_t> donors((i_end - i_begin) * W_out_);
+    forEachTile(i_begin, i_end, [&](const Tile& tile) { searchTile(tile, i_begin, donors.data()); });
+    return donors;
+}
+
+void CloudConstructor::forEachTile(size_t i_begin, size_t i_end, const std::function<void(const Tile&)>& fn) const {
+    const size_t tile = std::max<size_t>(search_options_.tile_size, 1);
+    const size_t rows = i_end - i_begin;
+    const size_t tile_cols = (W_out_ + tile - 1) / tile;
+    const size_t num_tiles = ((rows + tile - 1) / tile) * tile_cols;
+
+    // Every pixel belongs to exactly one tile
+    size_t threads = WorkerPool::workers(num_tiles, search_options_.threads);
+    WorkerPool::run(num_tiles, threads,
+        [&](size_t worker) {
+            // Only pool threads are pinned, a lone worker is the calling thread
+            int cpu = NumaTopology::system().cpuForWorker(worker, search_options_.pinning);
+            if (threads > 1 && cpu >= 0) {
+                NumaTopology::pinCurrentThread({cpu});
+            }
+        },
+        [&](size_t t, size_t) {
+            size_t r0 = i_begin + (t / tile_cols) * tile;
+            size_t c0 = (t % tile_cols) * tile;
+            fn(Tile{r0, c0, std::min(tile, i_end - r0), std::min(tile, W_out_ - c0)});
+        });
+}
+
+// Replica of the node the calling worker runs on
+const DonorSelector& CloudConstructor::workerSelector() const {
+    return replicas_.empty()
+        ? donor_selector_
+        : *replicas_[std::min(NumaTopology::system().currentNode(), replicas_.size() - 1)]->selector;
+}
+
+void CloudConstructor::searchTile(const Tile& tile, size_t i_begin, size_t* donors) const {
+    const DonorSelector& selector = workerSelector();
+    for (size_t i = tile.row; i < tile.row + tile.rows; ++i) {
+        for (size_t j = tile.col; j < tile.col + tile.cols; ++j) {
+            auto donor = selector.findBestDonor({i + i_min_, j + j_min_});
+            donors[(i - i_begin) * W_out_ + j] = donor.has_value() ? donor->first : std::numeric_limits<size_t>::max();
+        }
+    }
+}
+
+void CloudConstructor::mapTile(const Tile& tile) {
+    if (L_ == 0 || K_ == 0) {
+        return;
+    }
+    const size_t plane = H_out_ * W_out_ * K_;
+    for (size_t l = 0; l < L_; ++l) {
+        for (size_t i = tile.row; i < tile.row + tile.rows; ++i) {
+            double* row = data_out_ + flatIndex(i, tile.col, 0, l);
+            std::fill(row, row + tile.cols * K_, std::numeric_limits<double>::quiet_NaN());
+        }
+    }
+    for (size_t i = tile.row; i < tile.row + tile.rows; ++i) {
+        for (size_t j = tile.col; j < tile.col + tile.cols; ++j) {
+            size_t ac_idx = indices_out_[i * W_out_ + j];
+            if (ac_idx == std::numeric_limits<size_t>::max()) continue;
+            if (ac_idx + DEFF_IDX_ >= aux2d_->longitude.size()) {
+                throw std::out_of_range("AUX index out of range");
+            }
+            mapProfile(*acclp_, ac_idx, *aux2d_, ac_idx + DEFF_IDX_, K_, variables_,
+                       data_out_ + flatIndex(i, j, 0, 0), 1, plane);
+        }
+    }
+}
+
+CloudConstructor::MultiresolutionStats
+CloudConstructor::constructMultiresolution(const MultiresolutionOptions& options) {
+    std::cout << "[CloudConstructor] Starting multiresolution cloud construction (block size: "
+              << options.block_size << ", spectral threshold: " << options.spectral_threshold
+              << ", threads: " << search_options_.threads << ")" << std::endl;
+
+    const size_t NO_DONOR = std::numeric_limits<size_t>::max();
+    const size_t block = std::max<size_t>(options.block_size, 1);
+    std::vector<size_t> donors(H_out_ * W_out_, NO_DONOR);
+    std::vector<char> searched(H_out_ * W_out_, 0);
+    std::vector<double> donor_distance(H_out_ * W_out_, 0.0);  // Spectral distance to the donor, searched pixels
+
+    // Coarse sub-grid: every block_size-th row / column plus the last one
+    auto gridLines = [block](size_t n) {
+        std::vector<size_t> lines;
+        for (size_t x = 0; x < n; x += block) {
+            lines.push_back(x);
+        }
+        if (n > 0 && lines.back() != n - 1) {
+            lines.push_back(n - 1);
+        }
+        return lines;
+    };
+    std::vector<size_t> rows = gridLines(H_out_);
+    std::vector<size_t> cols = gridLines(W_out_);
+    // Grid lines of [begin, begin + count)
+    auto linesIn = [](const std::vector<size_t>& lines, size_t begin, size_t count) {
+        return std::make_pair(std::lower_bound(lines.begin(), lines.end(), begin),
+                              std::lower_bound(lines.begin(), lines.end(), begin + count));
+    };
+
+    // Each worker searches the grid points of its tiles
+    forEachTile(0, H_out_, [&](const Tile& tile) {
+        const DonorSelector& selector = workerSelector();
+        auto [row_begin, row_end] = linesIn(rows, tile.row, tile.rows);
+        auto [col_begin, col_end] = linesIn(cols, tile.col, tile.cols);
+        for (auto i = row_begin; i != row_end; ++i) {
+            for (auto j = col_begin; j != col_end; ++j) {
+                size_t pixel = *i * W_out_ + *j;
+                auto result = selector.findBestDonor({*i + i_min_, *j + j_min_});
+                donors[pixel] = result.has_value() ? result->first : NO_DONOR;
+                if (donors[pixel] != NO_DONOR) {
+                    donor_distance[pixel] = spectralDistance(*i + i_min_, *j + j_min_, donors[pixel]);
+                }
+                searched[pixel] = 1;
+            }
+        }
+    });
+
+    // Distance between the log spectra of two MSI pixels
+    auto pixelDistance = [this](size_t i, size_t j, size_t other_i, size_t other_j) {
+        double sum = 0.0;
+        for (size_t b = 0; b < msi_->bands(); ++b) {
+            double diff = std::log(msi_->radianceAt(i, j, b)) - std::log(msi_->radianceAt(other_i, other_j, b));
+            sum += diff * diff;
+        }
+        return std::sqrt(sum);
+    };
+
+    // Donor reused inside a block
+    struct SharedDonor {
+        size_t ac_idx;
+        size_t i, j;       // Corner it was found for
+        double reference;  // Spectral distance to that corner
+    };
+
+    // State of one coarse block [i0, i1] x [j0, j1], refined by a single worker.
+    // Its corners are grid points. An edge shared with a neighbouring block is
+    // filled by the block that owns it only (the other one may still search
+    // sub-block corners on it), so the result does not depend on the order in
+    // which workers take the blocks.
+    struct BlockState {
+        size_t i0, i1, j0, j1;
+        size_t own_i, own_j;  // First row / column owned by the block
+        std::vector<size_t> donors;
+        std::vector<char> searched;
+        std::vector<double> donor_distance;
+        size_t at(size_t i, size_t j) const { return (i - i0) * (j1 - j0 + 1) + (j - j0); }
+    };
+
+    auto search = [&](BlockState& state, const DonorSelector& selector, size_t i, size_t j) {
+        size_t pixel = state.at(i, j);
+        if (!state.searched[pixel]) {
+            auto result = selector.findBestDonor({i + i_min_, j + j_min_});
+            state.donors[pixel] = result.has_value() ? result->first : NO_DONOR;
+            if (state.donors[pixel] != NO_DONOR) {
+                state.donor_distance[pixel] = spectralDistance(i + i_min_, j + j_min_, state.donors[pixel]);
+            }
+            state.searched[pixel] = 1;
+        }
+        return state.donors[pixel];
+    };
+
+    // Acceptance rule of the donor search for a reused donor: the pixel state of
+    // the MSI pixel nearest to the AC_CLP point, as in DonorSelector
+    auto donorState = [this](size_t ac_idx) {
+        auto [nearest, distance] = MSI_CoordKDTree_.findNearest({acclp_->longitude[ac_idx], acclp_->latitude[ac_idx]});
+        size_t i = nearest / W_;
+        size_t j = nearest % W_;
+        return DonorSelector::PixelState{i, msi_->mu0[i][j], msi_->phi0[i][j], msi_->surface_type[i][j]};
+    };
+    auto reusable = [&](size_t i, size_t j, const SharedDonor& shared, const DonorSelector::PixelState& donor) {
+        size_t src_i = i + i_min_;
+        size_t src_j = j + j_min_;
+        DonorSelector::PixelState target{src_i, msi_->mu0[src_i][src_j], msi_->phi0[src_i][src_j],
+                                         msi_->surface_type[src_i][src_j]};
+        // Heuristic estimate of how much farther the reused donor is than the
+        // pixel's own: the corner's donor distance, less the spectral step from
+        // the corner, stands in for the pixel's exact donor distance. It is not a
+        // bound, since the exact donor is the first admissible of the k candidates
+        // (or the fallback) rather than the spectrally nearest point; the index
+        // agreement of the regression check (about 0.6 on multires_noisy) measures the error.
+        double excess = spectralDistance(src_i, src_j, shared.ac_idx) - shared.reference +
+                        pixelDistance(src_i, src_j, shared.i + i_min_, shared.j + j_min_);
+        return excess <= options.spectral_threshold &&
+               DonorSelector::isAdmissible(target, donor, max_idx_distance_,
+                                           donor_selector_.deltaMu0(), donor_selector_.deltaPhi0());
+    };
+
+    // Donors a block may share: the corner donors whose spectral distance to
+    // every corner exceeds that corner's own (exact) donor distance by at most
+    // the threshold, smallest excess first. Corner donors may differ in index and
+    // still be spectrally equivalent.
+    auto sharedDonors = [&](BlockState& state, const DonorSelector& selector,
+                            size_t i0, size_t i1, size_t j0, size_t j1) {
+        const size_t corners[4][2] = {{i0, j0}, {i0, j1}, {i1, j0}, {i1, j1}};
+        std::vector<std::pair<double, SharedDonor>> candidates;
+        for (const auto& corner : corners) {
+            if (search(state, selector, corner[0], corner[1]) == NO_DONOR) return std::vector<SharedDonor>();
+        }
+        for (const auto& corner : corners) {
+            size_t candidate = state.donors[state.at(corner[0], corner[1])];
+            bool seen = false;
+            for (const auto& c : candidates) seen = seen || c.second.ac_idx == candidate;
+            if (seen) continue;
+            double excess = 0.0;
+            for (const auto& other : corners) {
+                double distance = spectralDistance(other[0] + i_min_, other[1] + j_min_, candidate);
+                excess = std::max(excess, distance - state.donor_distance[state.at(other[0], other[1])]);
+            }
+            if (excess <= options.spectral_threshold) {
+                candidates.push_back({excess, {candidate, corner[0], corner[1],
+                                               state.donor_distance[state.at(corner[0], corner[1])]}});
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(),
+                  [](const auto& a, const auto& b) { return a.first < b.first; });
+        std::vector<SharedDonor> shared;
+        for (const auto& c : candidates) shared.push_back(c.second);
+        return shared;
+    };
+
+    // Blocks with shared donors give every pixel the first one it is admissible
+    // for and whose estimated excess over its own donor is within the
+    // threshold; the other pixels are searched. Blocks without one are split in
+    // four and refined.
+    std::function<void(BlockState&, const DonorSelector&, size_t, size_t, size_t, size_t)> refine =
+        [&](BlockState& state, const DonorSelector& selector, size_t i0, size_t i1, size_t j0, size_t j1) {
+        std::vector<SharedDonor> shared = sharedDonors(state, selector, i0, i1, j0, j1);
+        bool leaf = i1 - i0 <= 1 && j1 - j0 <= 1;
+
+        if (!shared.empty() || leaf) {
+            std::vector<std::optional<DonorSelector::PixelState>> shared_state(shared.size());
+            for (size_t i = i0; i <= i1; ++i) {
+                for (size_t j = std::max(j0, state.own_j); j <= j1; ++j) {
+                    size_t pixel = state.at(i, j);
+                    if (i < state.own_i || state.searched[pixel] || state.donors[pixel] != NO_DONOR) continue;
+                    for (size_t s = 0; s < shared.size() && state.donors[pixel] == NO_DONOR; ++s) {
+                        if (!shared_state[s]) shared_state[s] = donorState(shared[s].ac_idx);
+                        if (reusable(i, j, shared[s], *shared_state[s])) {
+                            state.donors[pixel] = shared[s].ac_idx;
+                        }
+                    }
+                    if (state.donors[pixel] == NO_DONOR) {
+                        search(state, selector, i, j);
+                    }
+                }
+            }
+            return;
+        }
+
+        size_t im = (i0 + i1) / 2;
+        size_t jm = (j0 + j1) / 2;
+        refine(state, selector, i0, im, j0, jm);
+        if (jm < j1) refine(state, selector, i0, im, jm, j1);
+        if (im < i1) refine(state, selector, im, i1, j0, jm);
+        if (im < i1 && jm < j1) refine(state, selector, im, i1, jm, j1);
+    };
+
+    // Block (r, c) spans grid lines r, r + 1 and c, c + 1 and owns its far edges;
+    // the first block row / column also owns the near ones. Grid points are final.
+    const size_t num_row_blocks = rows.empty() ? 0 : std::max<size_t>(rows.size(), 2) - 1;
+    const size_t num_col_blocks = cols.empty() ? 0 : std::max<size_t>(cols.size(), 2) - 1;
+    auto refineBlock = [&](const DonorSelector& selector, size_t r, size_t c) {
+        BlockState state;
+        state.i0 = rows[r];
+        state.i1 = (r + 1 < rows.size()) ? rows[r + 1] : state.i0;
+        state.j0 = cols[c];
+        state.j1 = (c + 1 < cols.size()) ? cols[c + 1] : state.j0;
+        state.own_i = (r == 0) ? state.i0 : state.i0 + 1;
+        state.own_j = (c == 0) ? state.j0 : state.j0 + 1;
+        size_t size = (state.i1 - state.i0 + 1) * (state.j1 - state.j0 + 1);
+        state.donors.assign(size, NO_DONOR);
+        state.searched.assign(size, 0);
+        state.donor_distance.assign(size, 0.0);
+        for (size_t i : {state.i0, state.i1}) {
+            for (size_t j : {state.j0, state.j1}) {
+                state.donors[state.at(i, j)] = donors[i * W_out_ + j];
+                state.donor_distance[state.at(i, j)] = donor_distance[i * W_out_ + j];
+                state.searched[state.at(i, j)] = 1;
+            }
+        }
+        refine(state, selector, state.i0, state.i1, state.j0, state.j1);
+
+        for (size_t i = state.own_i; i <= state.i1; ++i) {
+            bool grid_row = i == state.i0 || i == state.i1;
+            for (size_t j = state.own_j; j <= state.j1; ++j) {
+                if (grid_row && (j == state.j0 || j == state.j1)) continue;
+                donors[i * W_out_ + j] = state.donors[state.at(i, j)];
+                searched[i * W_out_ + j] = state.searched[state.at(i, j)];
+            }
+        }
+    };
+    // Each worker refines the blocks whose top-left grid point lies in its tiles
+    forEachTile(0, H_out_, [&](const Tile& tile) {
+        const DonorSelector& selector = workerSelector();
+        auto [row_begin, row_end] = linesIn(rows, tile.row, tile.rows);
+        auto [col_begin, col_end] = linesIn(cols, tile.col, tile.cols);
+        for (auto i = row_begin; i != row_end; ++i) {
+            size_t r = i - rows.begin();
+            if (r >= num_row_blocks) continue;
+            for (auto j = col_begin; j != col_end; ++j) {
+                size_t c = j - cols.begin();
+                if (c < num_col_blocks) refineBlock(selector, r, c);
+            }
+        }
+    });
+
+    MultiresolutionStats stats;
+    stats.total_pixels = H_out_ * W_out_;
+    for (size_t pixel = 0; pixel < stats.total_pixels; ++pixel) {
+        stats.searched_pixels += searched[pixel];
+        size_t i = pixel / W_out_;
+        size_t j = pixel % W_out_;
+        if (donors[pixel] == NO_DONOR) {
+            assignDonor(i, j, std::nullopt);
+        } else {
+            assignDonor(i, j, DonorSelector::Donor{donors[pixel], 0.0});
+        }
+    }
+    mapVariables();
+    stats.searched_fraction = stats.total_pixels
+                            ? static_cast<double>(stats.searched_pixels) / stats.total_pixels : 0.0;
+
+    // Agreement with the full-resolution search (reused pixels only can differ)
+    if (options.validate) {
+        std::vector<size_t> full = searchRows(0, H_out_);
+        size_t agree = 0;
+        for (size_t pixel = 0; pixel < stats.total_pixels; ++pixel) {
+            agree += (searched[pixel] || full[pixel] == donors[pixel]) ? 1 : 0;
+        }
+        stats.agreement = stats.total_pixels ? static_cast<double>(agree) / stats.total_pixels : 1.0;
+    }
+
+    std::cout << "[CloudConstructor] Searched " << stats.searched_pixels << " / " << stats.total_pixels
+              << " pixels (fraction: " << stats.searched_fraction << ")" << std::endl;
+    if (options.validate) {
+        std::cout << "[CloudConstructor] Agreement with full resolution: " << stats.agreement << std::endl;
+    }
+    std::cout << "[CloudConstructor] Multiresolution cloud construction completed successfully" << std::endl;
+    return stats;
+}
+
+void CloudConstructor::constructSweep(const std::vector<DonorSelector::Criteria>& criteria) {
+    std::cout << "[CloudConstructor] Starting parameter sweep over " << criteria.size() << " configurations" << std::endl;
+
+    size_t num_pixels = H_out_ * W_out_;
+    sweep_indices_.assign(criteria.size() * num_pixels, std::numeric_limits<size_t>::max());
+    if (criteria.empty()) {
+        return;
+    }
 
-    // Iterate over each pixel in the MSI data
     for (size_t i = 0; i < H_out_; ++i) {
         for (size_t j = 0; j < W_out_; ++j) {
             size_t src_i = i + i_min_;
             size_t src_j = j + j_min_;
-            auto result = donor_selector_.findBestDonor({src_i, src_j});
-
-            if (!result.has_value()) {
-                mapped_indices_[i * W_ + j] = std::numeric_limits<size_t>::max();
-                for (size_t k = 0; k < K_; ++k) {
-                    for (size_t l = 0; l < L_; ++l) {
-                        size_t idx = flatIndex(i, j, k, l);
-                        mapped_data_[idx] = std::numeric_limits<double>::quiet_NaN();
-                    }
-                }
-                continue;
+            auto donors = donor_selector_.findBestDonors({src_i, src_j}, criteria);
+            for (size_t c = 0; c < criteria.size(); ++c) {
+                sweep_indices_[c * num_pixels + i * W_out_ + j] = donors[c].first;
             }
+        }
+    }
+    std::cout << "[CloudConstructor] Parameter sweep completed successfully" << std::endl;
+}
 
-            size_t ac_idx = result->first;
-            mapped_indices_[i * W_ + j] = ac_idx;
-            mapVariables(i, j, ac_idx);
+void CloudConstructor::assignDonor(size_t i, size_t j, const std::optional<DonorSelector::Donor>& donor) {
+    indices_out_[i * W_out_ + j] = donor.has_value() ? donor->first : std::numeric_limits<size_t>::max();
+}
+
+// Distance between the log spectrum of an MSI pixel and the log spectrum of an AC_CLP point
+double CloudConstructor::spectralDistance(size_t src_i, size_t src_j, size_t ac_idx) const {
+    const auto& ac_spectrum = acclp_->radiance[ac_idx];
+    double sum = 0.0;
+    for (size_t b = 0; b < msi_->bands(); ++b) {
+        double diff = std::log(msi_->radianceAt(src_i, src_j, b)) - ac_spectrum[b];
+        sum += diff * diff;
+    }
+    return std::sqrt(sum);
+}
+
+// Fetches the profiles of the assigned donors through the loader, if any
+void CloudConstructor::loadProfiles() {
+    if (!profile_loader_) {
+        return;
+    }
+    const size_t NO_DONOR = std::numeric_limits<size_t>::max();
+    std::vector<size_t> ac_rows;
+    for (size_t pixel = 0; pixel < H_out_ * W_out_; ++pixel) {
+        if (indices_out_[pixel] != NO_DONOR) ac_rows.push_back(indices_out_[pixel]);
+    }
+    std::sort(ac_rows.begin(), ac_rows.end());
+    ac_rows.erase(std::unique(ac_rows.begin(), ac_rows.end()), ac_rows.end());
+    std::vector<size_t> aux_rows(ac_rows.size());
+    for (size_t r = 0; r < ac_rows.size(); ++r) {
+        aux_rows[r] = ac_rows[r] + DEFF_IDX_;
+    }
+    std::cout << "[CloudConstructor] Loading profiles of " << ac_rows.size() << " unique donors" << std::endl;
+    profile_loader_(ac_rows, aux_rows);
+}
+
+// Profiles of the assigned donors; unassigned pixels stay NaN
+void CloudConstructor::mapVariables() {
+    loadProfiles();
+    forEachTile(0, H_out_, [this](const Tile& tile) {
+        mapTile(tile);
+        if (tile_callback_) tile_callback_(tile);
+    });
+}
+
+void CloudConstructor::mapProfile(const AC_CLP_Data& acclp, size_t ac_idx,
+                                  const AUX__2D_Data& aux2d, size_t aux_idx,
+                                  size_t K, const std::vector<size_t>& variables, double* out,
+                                  size_t level_stride, size_t variable_stride) {
+    const size_t L = variables.size();
+    const size_t ac = acclp.profileRow(ac_idx);
+    const size_t aux = aux2d.profileRow(aux_idx);
+    if (level_stride == 0) {
+        level_stride = L;
+    }
+    for (size_t k = 0; k < K; ++k) {
+        double* level = out + k * level_stride;
+        for (size_t l = 0; l < L; ++l) {
+            double& value = level[l * variable_stride];
+            switch (variables[l]) {
+                case 0:  value = acclp.cloud_effective_radius1[ac][k]; break;
+                case 1:  value = acclp.cloud_effective_radius2[ac][k]; break;
+                case 2:  value = acclp.cloud_water_content1[ac][k]; break;
+                case 3:  value = acclp.cloud_water_content2[ac][k]; break;
+                case 4:  value = acclp.cloud_phase1[ac][k]; break;
+                case 5:  value = acclp.cloud_phase2[ac][k]; break;
+                case 6:  value = acclp.radar_lidar_flag[ac][k]; break;
+                case 7:  value = acclp.height[ac][k]; break;
+                case 8:  value = aux2d.ozoneMassMixingRatio[aux][K - 1 - k]; break;
+                case 9:  value = aux2d.pressure[aux][K - 1 - k]; break;
+                case 10: value = aux2d.specificHumidity[aux][K - 1 - k]; break;
+                case 11: value = aux2d.temperature[aux][K - 1 - k]; break;
+                case 12: value = aux2d.height[aux][K - 1 - k]; break;
+            }
         }
     }
-    std::cout << "[CloudConstructor] Cloud construction completed successfully" << std::endl;
 }
 
-void CloudConstructor::mapVariables(size_t i, size_t j, size_t ac_idx) {
-    size_t aux_idx = ac_idx + DEFF_IDX_;
-    for (size_t k = 0; k < K_; ++k) {
-        mapped_data_[flatIndex(i, j, k, 0)] = acclp_->cloud_effective_radius1[ac_idx][k];
-        mapped_data_[flatIndex(i, j, k, 1)] = acclp_->cloud_effective_radius2[ac_idx][k];
-        mapped_data_[flatIndex(i, j, k, 2)] = acclp_->cloud_water_content1[ac_idx][k];
-        mapped_data_[flatIndex(i, j, k, 3)] = acclp_->cloud_water_content2[ac_idx][k];
-        mapped_data_[flatIndex(i, j, k, 4)] = acclp_->cloud_phase1[ac_idx][k];
-        mapped_data_[flatIndex(i, j, k, 5)] = acclp_->cloud_phase2[ac_idx][k];
-        mapped_data_[flatIndex(i, j, k, 6)] = acclp_->radar_lidar_flag[ac_idx][k];
-        mapped_data_[flatIndex(i, j, k, 7)] = acclp_->height[ac_idx][k];
-        mapped_data_[flatIndex(i, j, k, 8)] = aux2d_->ozoneMassMixingRatio[aux_idx][K_ - 1 - k];
-        mapped_data_[flatIndex(i, j, k, 9)] = aux2d_->pressure[aux_idx][K_ - 1 - k];
-        mapped_data_[flatIndex(i, j, k, 10)] = aux2d_->specificHumidity[aux_idx][K_ - 1 - k];
-        mapped_data_[flatIndex(i, j, k, 11)] = aux2d_->temperature[aux_idx][K_ - 1 - k];
-        mapped_data_[flatIndex(i, j, k, 12)] = aux2d_->height[aux_idx][K_ - 1 - k];
+void CloudConstructor::mapSurface(const AUX__2D_Data& aux2d, size_t aux_idx, const std::vector<size_t>& variables,
+                                  double* out, size_t stride) {
+    const size_t aux = aux2d.profileRow(aux_idx);
+    for (size_t s = 0; s < variables.size(); ++s) {
+        double& value = out[s * stride];
+        switch (variables[s]) {
+            case SURFACE_PRESSURE:         value = surfaceValue(aux2d.surfacePressure, aux); break;
+            case TOTAL_COLUMN_OZONE:       value = surfaceValue(aux2d.totalColumnOzone, aux); break;
+            case TOTAL_COLUMN_WATER_VAPOR: value = surfaceValue(aux2d.totalColumnWaterVapor, aux); break;
+            case DAY_NIGHT_FLAG:           value = surfaceValue(aux2d.day_night_flag, aux); break;
+            case LAND_WATER_FLAG:          value = surfaceValue(aux2d.land_water_flag, aux); break;
+        }
     }
 }
@@ -1,6 +1,7 @@
 #include "DonorSelector.hpp"
 #include "KDTreeSearcher.hpp"
 #include <cmath>
+#include <algorithm>
 #include <limits>
 #include <stdexcept>
 
@@ -26,56 +27,91 @@ std::pair<size_t, size_t> DonorSelector::findNearestMSIindex(const size_t acclp_
 
     auto [nearest_index, distance] = MSI_CoordKDTree_.findNearest(query);
 
-    size_t W = msi_->longitude[0].size();
+    size_t W = msi_->width();
     size_t i = nearest_index / W;
     size_t j = nearest_index % W;
     return {i, j};
 }
 
-std::optional<std::pair<size_t, double>> DonorSelector::findBestDonor(std::pair<size_t, size_t> target_index) const {
-
-    size_t num_band = msi_->radiance[0][0].size();
+KDTreeSearcherBand::Spectrum DonorSelector::logSpectrum(const std::pair<size_t, size_t>& msi_index) const {
+    size_t num_band = msi_->bands();
     KDTreeSearcherBand::Spectrum log_query;
     for (size_t i = 0; i < num_band; ++i) {
-        log_query[i] = std::log(msi_->radiance[target_index.first][target_index.second][i]);
+        log_query[i] = std::log(msi_->radianceAt(msi_index.first, msi_index.second, i));
     }
+    return log_query;
+}
 
-    // Find the k nearest candidates in the spectral KDTree (AC_CLP index)
-    auto candidate_indices = AC_SpectralKDTree_.findKNearest(log_query, k_candidates_);
-    size_t closest_acclp_index = findNearestACCLPindex(target_index);
+DonorSelector::PixelState DonorSelector::pixelState(const std::pair<size_t, size_t>& msi_index) const {
+    return {msi_index.first,
+            msi_->mu0[msi_index.first][msi_index.second],
+            msi_->phi0[msi_index.first][msi_index.second],
+            msi_->surface_type[msi_index.first][msi_index.second]};
+}
+
+std::optional<DonorSelector::Donor> DonorSelector::selectCandidate(
+        const std::pair<size_t, size_t>& target_index,
+        const std::vector<Donor>& candidates,
+        std::vector<std::optional<MSIIndex>>& msi_cache,
+        size_t k_candidates, size_t max_idx_distance,
+        double delta_mu0, double delta_phi0) const {
 
     // Find the index that satisfies the conditions
-    double mu0_ij = msi_->mu0[target_index.first][target_index.second];
-    double phi0_ij = msi_->phi0[target_index.first][target_index.second];
-    double surface_type_ij = msi_->surface_type[target_index.first][target_index.second];
-
-    size_t best_index = candidate_indices[0].first;
-    double best_distance = candidate_indices[0].second;
-    bool found = false;
-
-    for (size_t k = 0; k < candidate_indices.size(); ++k) {
-        size_t candidate_index = candidate_indices[k].first;
-        auto msi_index = findNearestMSIindex(candidate_index);
-        double distance = candidate_indices[k].second;
-        size_t idx_diff = (msi_index.first > target_index.first) ? 
-                          msi_index.first - target_index.first : 
-                          target_index.first - msi_index.first;
-
-        // Check conditions
-        if (idx_diff <= max_idx_distance_ &&
-            std::abs(msi_->mu0[msi_index.first][msi_index.second] - mu0_ij) < delta_mu0_ &&
-            std::abs(msi_->phi0[msi_index.first][msi_index.second] - phi0_ij) < delta_phi0_ &&
-            msi_->surface_type[msi_index.first][msi_index.second] == surface_type_ij) {
-            best_index = candidate_index;
-            best_distance = distance;
-            found = true;
-            break;
+    PixelState target = pixelState(target_index);
+
+    size_t num_candidates = std::min(k_candidates, candidates.size());
+    for (size_t k = 0; k < num_candidates; ++k) {
+        if (!msi_cache[k].has_value()) {
+            msi_cache[k] = findNearestMSIindex(candidates[k].first);
+        }
+        if (isAdmissible(target, pixelState(*msi_cache[k]), max_idx_distance, delta_mu0, delta_phi0)) {
+            return candidates[k];
         }
     }
+    return std::nullopt;
+}
+
+std::optional<DonorSelector::Donor> DonorSelector::findBestDonor(std::pair<size_t, size_t> target_index) const {
+    KDTreeSearcherBand::Spectrum log_query = logSpectrum(target_index);
+
+    // Find the k nearest candidates in the spectral KDTree (AC_CLP index)
+    auto candidate_indices = AC_SpectralKDTree_.findKNearest(log_query, k_candidates_);
+    std::vector<std::optional<MSIIndex>> msi_cache(candidate_indices.size());
+
+    auto donor = selectCandidate(target_index, candidate_indices, msi_cache,
+                                 k_candidates_, max_idx_distance_, delta_mu0_, delta_phi0_);
+    if (!donor.has_value()) {
+        // Fall back to the geographically closest AC_CLP point
+        donor = Donor{findNearestACCLPindex(target_index), 0.0};
+    }
+    return donor;
+}
+
+std::vector<DonorSelector::Donor> DonorSelector::findBestDonors(std::pair<size_t, size_t> target_index,
+                                                                const std::vector<Criteria>& criteria) const {
+    size_t max_k = 0;
+    for (const auto& c : criteria) {
+        max_k = std::max(max_k, c.k_candidates);
+    }
 
-    if (!found) {
-        best_index = closest_acclp_index;
-        best_distance = 0.0;
+    // A single spectral search at the largest k; smaller k use its prefix
+    KDTreeSearcherBand::Spectrum log_query = logSpectrum(target_index);
+    auto candidate_indices = AC_SpectralKDTree_.findKNearest(log_query, max_k);
+    std::vector<std::optional<MSIIndex>> msi_cache(candidate_indices.size());
+    std::optional<size_t> closest_acclp_index;
+
+    std::vector<Donor> donors;
+    donors.reserve(criteria.size());
+    for (const auto& c : criteria) {
+        auto donor = selectCandidate(target_index, candidate_indices, msi_cache,
+                                     c.k_candidates, c.max_idx_distance, c.delta_mu0, c.delta_phi0);
+        if (!donor.has_value()) {
+            if (!closest_acclp_index.has_value()) {
+                closest_acclp_index = findNearestACCLPindex(target_index);
+            }
+            donor = Donor{*closest_acclp_index, 0.0};
+        }
+        donors.push_back(*donor);
     }
-    return {{best_index, best_distance}};
+    return donors;
 }
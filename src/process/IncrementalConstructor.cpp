@@ -0,0 +1,353 @@
+#include "IncrementalConstructor.hpp"
+#include "CloudConstructor.hpp"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+IncrementalConstructor::IncrementalConstructor(RowCallback on_rows,
+                                               size_t k_candidates,
+                                               size_t max_idx_distance,
+                                               size_t num_vertical_levels,
+                                               size_t aux_offset,
+                                               size_t settle_margin)
+    : on_rows_(std::move(on_rows)),
+      k_candidates_(k_candidates),
+      max_idx_distance_(max_idx_distance),
+      K_(num_vertical_levels),
+      L_(CloudConstructor::NUM_PROFILE_VARIABLES),
+      aux_offset_(aux_offset),
+      settle_margin_(settle_margin),
+      variables_(L_),
+      surface_variables_(CloudConstructor::surfaceVariableNames().size())
+{
+    for (size_t l = 0; l < L_; ++l) {
+        variables_[l] = l;
+    }
+    for (size_t s = 0; s < surface_variables_.size(); ++s) {
+        surface_variables_[s] = s;
+    }
+    std::cout << "[IncrementalConstructor] Using k_candidates: " << k_candidates_ << std::endl;
+    std::cout << "[IncrementalConstructor] Using max_idx_distance: " << max_idx_distance_ << std::endl;
+}
+
+void IncrementalConstructor::selectVariables(const std::vector<size_t>& profile_variables,
+                                             const std::vector<size_t>& surface_variables) {
+    for (size_t v : profile_variables) {
+        if (v >= CloudConstructor::NUM_PROFILE_VARIABLES) {
+            throw std::out_of_range("Profile variable index out of range: " + std::to_string(v));
+        }
+    }
+    for (size_t v : surface_variables) {
+        if (v >= CloudConstructor::surfaceVariableNames().size()) {
+            throw std::out_of_range("Surface variable index out of range: " + std::to_string(v));
+        }
+    }
+    variables_ = profile_variables;
+    surface_variables_ = surface_variables;
+    L_ = variables_.size();
+}
+
+void IncrementalConstructor::appendMSI(std::unique_ptr<MSI_RGR_Data> segment) {
+    size_t rows = segment->longitude.size();
+    if (rows == 0) return;
+    size_t width = segment->width();
+    if (W_ == 0) {
+        W_ = width;
+    } else if (width != W_) {
+        throw std::invalid_argument("MSI segment width differs from previous segments");
+    }
+
+    std::vector<KDTreeSearcherCoord::Point> coords;
+    coords.reserve(rows * width);
+    for (size_t i = 0; i < rows; ++i) {
+        for (size_t j = 0; j < width; ++j) {
+            coords.push_back({segment->longitude[i][j], segment->latitude[i][j]});
+        }
+    }
+    msi_coord_trees_.push_back(std::make_unique<KDTreeSearcherCoord>(coords));
+    msi_segments_.push_back({msi_rows_, rows, std::move(segment)});
+    msi_rows_ += rows;
+}
+
+void IncrementalConstructor::appendACCLP(std::unique_ptr<AC_CLP_Data> segment) {
+    size_t count = segment->longitude.size();
+    if (count == 0) return;
+    if (K_ == 0) {
+        K_ = segment->height.extent(1);
+    }
+    acclp_segments_.push_back({acclp_points_, count, std::move(segment)});
+    acclp_points_ += count;
+}
+
+void IncrementalConstructor::appendAUX(std::unique_ptr<AUX__2D_Data> segment) {
+    size_t count = segment->surfacePressure.size();
+    if (count == 0) return;
+    aux_segments_.push_back({aux_points_, count, std::move(segment)});
+    aux_points_ += count;
+}
+
+void IncrementalConstructor::process() {
+    settle();
+    buildRuns();
+    size_t end_row = rowBound();
+    if (end_row > next_row_) {
+        emitRows(end_row);
+    }
+    expire();
+}
+
+void IncrementalConstructor::finish() {
+    finished_ = true;
+    process();
+    std::cout << "[IncrementalConstructor] Stream finished after " << next_row_ << " rows" << std::endl;
+}
+
+// Nearest received MSI pixel of a geographic point
+bool IncrementalConstructor::nearestMSIPixel(const KDTreeSearcherCoord::Point& query,
+                                             size_t& row, size_t& col) const {
+    double best = std::numeric_limits<double>::infinity();
+    bool found = false;
+    for (size_t s = 0; s < msi_segments_.size(); ++s) {
+        auto [index, distance] = msi_coord_trees_[s]->findNearest(query);
+        if (distance < best) {
+            best = distance;
+            row = msi_segments_[s].first + index / W_;
+            col = index % W_;
+            found = true;
+        }
+    }
+    return found;
+}
+
+const IncrementalConstructor::Segment<MSI_RGR_Data>& IncrementalConstructor::msiSegment(size_t row) const {
+    for (const auto& segment : msi_segments_) {
+        if (row >= segment.first && row < segment.first + segment.count) {
+            return segment;
+        }
+    }
+    throw std::out_of_range("MSI row " + std::to_string(row) + " is not available");
+}
+
+// AC_CLP points are settled in along-track order: a point is settled once its
+// nearest MSI row is at least settle_margin rows behind the last received row
+void IncrementalConstructor::settle() {
+    for (auto& segment : acclp_segments_) {
+        if (segment.first + segment.count <= settled_points_) continue;
+        for (size_t n = settled_points_ - segment.first; n < segment.count; ++n) {
+            KDTreeSearcherCoord::Point coord = {segment.data->longitude[n], segment.data->latitude[n]};
+            size_t row, col;
+            if (!nearestMSIPixel(coord, row, col)) return;
+            if (!finished_ && row + settle_margin_ >= msi_rows_) return;
+
+            const auto& msi = msiSegment(row);
+            size_t local_row = row - msi.first;
+            SettledPoint point;
+            for (size_t b = 0; b < msi.data->bands(); ++b) {
+                point.spectrum[b] = std::log(msi.data->radianceAt(local_row, col, b));
+            }
+            point.coord = coord;
+            point.pixel = {row,
+                           msi.data->mu0[local_row][col],
+                           msi.data->phi0[local_row][col],
+                           msi.data->surface_type[local_row][col]};
+            unindexed_.push_back(point);
+            last_settled_row_ = std::max(last_settled_row_, row);
+            ++settled_points_;
+        }
+    }
+}
+
+std::unique_ptr<IncrementalConstructor::Run>
+IncrementalConstructor::makeRun(size_t first, std::vector<SettledPoint> points) const {
+    auto run = std::make_unique<Run>();
+    run->first = first;
+    run->count = points.size();
+    run->max_row = 0;
+    run->spectra.reserve(points.size());
+    run->coords.reserve(points.size());
+    run->pixels.reserve(points.size());
+    for (const auto& point : points) {
+        run->spectra.push_back(point.spectrum);
+        run->coords.push_back(point.coord);
+        run->pixels.push_back(point.pixel);
+        run->max_row = std::max(run->max_row, point.pixel.row);
+    }
+    run->spectral_tree.setData(run->spectra);
+    run->coord_tree.setData(run->coords);
+    return run;
+}
+
+// Newly settled points form a new run; runs of similar size are merged so
+// the number of live trees stays logarithmic in the window size
+void IncrementalConstructor::buildRuns() {
+    if (unindexed_.empty()) return;
+    size_t first = settled_points_ - unindexed_.size();
+    runs_.push_back(makeRun(first, std::move(unindexed_)));
+    unindexed_.clear();
+
+    while (runs_.size() >= 2 && runs_[runs_.size() - 1]->count >= runs_[runs_.size() - 2]->count) {
+        const Run& older = *runs_[runs_.size() - 2];
+        const Run& newer = *runs_[runs_.size() - 1];
+        std::vector<SettledPoint> merged;
+        merged.reserve(older.count + newer.count);
+        for (const Run* run : {&older, &newer}) {
+            for (size_t n = 0; n < run->count; ++n) {
+                merged.push_back({run->spectra[n], run->coords[n], run->pixels[n]});
+            }
+        }
+        auto run = makeRun(older.first, std::move(merged));
+        runs_.pop_back();
+        runs_.back() = std::move(run);
+    }
+}
+
+// Rows below the returned bound have every possibly admissible AC_CLP point indexed
+size_t IncrementalConstructor::rowBound() const {
+    if (finished_) {
+        return msi_rows_;
+    }
+    // Donor profiles of all indexed points must be available
+    if (aux_points_ < settled_points_ + aux_offset_) {
+        return next_row_;
+    }
+
+    // Lowest MSI row any not yet indexed AC_CLP point can map to; the track
+    // may step back by up to settle_margin rows between consecutive points
+    size_t lowest_pending_row = (last_settled_row_ > settle_margin_) ? last_settled_row_ - settle_margin_ : 0;
+    if (settled_points_ < acclp_points_ && msi_rows_ > settle_margin_) {
+        lowest_pending_row = std::max(lowest_pending_row, msi_rows_ - settle_margin_);
+    }
+    if (settled_points_ == 0 || lowest_pending_row <= max_idx_distance_) {
+        return next_row_;
+    }
+    return std::min(msi_rows_, lowest_pending_row - max_idx_distance_);
+}
+
+size_t IncrementalConstructor::findDonor(size_t row, size_t col) const {
+    const auto& msi = msiSegment(row);
+    size_t local_row = row - msi.first;
+
+    KDTreeSearcherBand::Spectrum log_query;
+    for (size_t b = 0; b < msi.data->bands(); ++b) {
+        log_query[b] = std::log(msi.data->radianceAt(local_row, col, b));
+    }
+    DonorSelector::PixelState target = {row,
+                                        msi.data->mu0[local_row][col],
+                                        msi.data->phi0[local_row][col],
+                                        msi.data->surface_type[local_row][col]};
+
+    // k nearest over all live runs, ordered by distance (ties by along-track index)
+    struct Candidate {
+        double distance;
+        size_t index;
+        const DonorSelector::PixelState* pixel;
+    };
+    std::vector<Candidate> candidates;
+    for (const auto& run : runs_) {
+        for (const auto& [local, distance] : run->spectral_tree.findKNearest(log_query, k_candidates_)) {
+            candidates.push_back({distance, run->first + local, &run->pixels[local]});
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+        return a.distance < b.distance || (a.distance == b.distance && a.index < b.index);
+    });
+    size_t num_candidates = std::min(k_candidates_, candidates.size());
+    for (size_t k = 0; k < num_candidates; ++k) {
+        if (DonorSelector::isAdmissible(target, *candidates[k].pixel,
+                                        max_idx_distance_, delta_mu0_, delta_phi0_)) {
+            return candidates[k].index;
+        }
+    }
+
+    // Fall back to the geographically closest live AC_CLP point
+    KDTreeSearcherCoord::Point query = {msi.data->longitude[local_row][col], msi.data->latitude[local_row][col]};
+    double best = std::numeric_limits<double>::infinity();
+    size_t closest = std::numeric_limits<size_t>::max();
+    for (const auto& run : runs_) {
+        auto [local, distance] = run->coord_tree.findNearest(query);
+        if (distance < best) {
+            best = distance;
+            closest = run->first + local;
+        }
+    }
+    return closest;
+}
+
+void IncrementalConstructor::emitRows(size_t end_row) {
+    EmittedRows rows;
+    rows.first_row = next_row_;
+    rows.num_rows = end_row - next_row_;
+    rows.width = W_;
+    rows.K = K_;
+    rows.L = L_;
+    rows.S = surface_variables_.size();
+    size_t num_pixels = rows.num_rows * W_;
+    rows.mapped_indices.assign(num_pixels, std::numeric_limits<size_t>::max());
+    rows.mapped_data.assign(L_ * num_pixels * K_, std::numeric_limits<double>::quiet_NaN());
+    rows.surface.assign(rows.S * num_pixels, std::numeric_limits<double>::quiet_NaN());
+    rows.latitude.resize(num_pixels);
+    rows.longitude.resize(num_pixels);
+
+    auto findSegment = [](const auto& segments, size_t index) -> const auto& {
+        for (const auto& segment : segments) {
+            if (index >= segment.first && index < segment.first + segment.count) {
+                return segment;
+            }
+        }
+        throw std::out_of_range("Index " + std::to_string(index) + " is not available");
+    };
+
+    for (size_t r = 0; r < rows.num_rows; ++r) {
+        size_t row = next_row_ + r;
+        const auto& msi = msiSegment(row);
+        size_t local_row = row - msi.first;
+        for (size_t j = 0; j < W_; ++j) {
+            size_t pixel = r * W_ + j;
+            rows.latitude[pixel] = msi.data->latitude[local_row][j];
+            rows.longitude[pixel] = msi.data->longitude[local_row][j];
+
+            size_t ac_idx = findDonor(row, j);
+            if (ac_idx == std::numeric_limits<size_t>::max()) continue;
+            size_t aux_idx = ac_idx + aux_offset_;
+            const auto& acclp = findSegment(acclp_segments_, ac_idx);
+            const auto& aux = findSegment(aux_segments_, aux_idx);
+            size_t ac_local = ac_idx - acclp.first;
+            size_t aux_local = aux_idx - aux.first;
+
+            rows.mapped_indices[pixel] = ac_idx;
+            CloudConstructor::mapProfile(*acclp.data, ac_local, *aux.data, aux_local, K_, variables_,
+                                         &rows.mapped_data[pixel * K_], 1, num_pixels * K_);
+            CloudConstructor::mapSurface(*aux.data, aux_local, surface_variables_, &rows.surface[pixel], num_pixels);
+        }
+    }
+
+    next_row_ = end_row;
+    std::cout << "[IncrementalConstructor] Emitting rows " << rows.first_row << " - " << end_row - 1
+              << " (" << runs_.size() << " live trees)" << std::endl;
+    on_rows_(rows);
+}
+
+// Drop trees, profiles and MSI rows no future row can use
+void IncrementalConstructor::expire() {
+    while (!runs_.empty() && runs_.front()->max_row + max_idx_distance_ < next_row_) {
+        runs_.erase(runs_.begin());
+    }
+
+    size_t first_live_point = runs_.empty() ? settled_points_ : runs_.front()->first;
+    while (!acclp_segments_.empty() &&
+           acclp_segments_.front().first + acclp_segments_.front().count <= first_live_point) {
+        acclp_segments_.pop_front();
+    }
+    while (!aux_segments_.empty() &&
+           aux_segments_.front().first + aux_segments_.front().count <= first_live_point + aux_offset_) {
+        aux_segments_.pop_front();
+    }
+    while (msi_segments_.size() > 1) {
+        size_t last_row = msi_segments_.front().first + msi_segments_.front().count - 1;
+        if (last_row >= next_row_ || last_row + settle_margin_ >= last_settled_row_) break;
+        msi_segments_.pop_front();
+        msi_coord_trees_.pop_front();
+    }
+}
@@ -0,0 +1,198 @@
+#include "NumaTopology.hpp"
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+#include <filesystem>
+#include <cctype>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+namespace {
+
+const char* kNodeDir = "/sys/devices/system/node";
+
+// "0-3,8,10-11" -> {0, 1, 2, 3, 8, 10, 11}
+std::vector<int> parseCpuList(const std::string& list) {
+    std::vector<int> cpus;
+    std::stringstream ranges(list);
+    std::string range;
+    while (std::getline(ranges, range, ',')) {
+        if (range.empty() || range == "\n") continue;
+        size_t dash = range.find('-');
+        int first = std::stoi(range.substr(0, dash));
+        int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+bool allowedCpu(const cpu_set_t& allowed, int cpu) {
+    return cpu >= 0 && cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed);
+}
+
+} // namespace
+
+const NumaTopology& NumaTopology::system() {
+    static const NumaTopology topology;
+    return topology;
+}
+
+NumaTopology::NumaTopology() {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        for (unsigned cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); ++cpu) {
+            CPU_SET(cpu, &allowed);
+        }
+    }
+
+    // node<N>/cpulist of every node with CPUs this process may use
+    namespace fs = std::filesystem;
+    std::vector<std::pair<int, std::vector<int>>> nodes;
+    std::error_code error;
+    for (const auto& entry : fs::directory_iterator(kNodeDir, error)) {
+        std::string name = entry.path().filename().string();
+        if (name.rfind("node", 0) != 0 || name.size() == 4 ||
+            !std::all_of(name.begin() + 4, name.end(), ::isdigit)) continue;
+        std::ifstream in(entry.path() / "cpulist");
+        std::string list;
+        std::getline(in, list);
+        std::vector<int> cpus;
+        for (int cpu : parseCpuList(list)) {
+            if (allowedCpu(allowed, cpu)) cpus.push_back(cpu);
+        }
+        if (!cpus.empty()) {
+            nodes.emplace_back(std::stoi(name.substr(4)), std::move(cpus));
+        }
+    }
+    std::sort(nodes.begin(), nodes.end());
+    for (auto& node : nodes) {
+        node_ids_.push_back(node.first);
+        node_cpus_.push_back(std::move(node.second));
+    }
+
+    if (node_cpus_.empty()) {
+        node_ids_.push_back(0);
+        node_cpus_.emplace_back();
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &allowed)) node_cpus_[0].push_back(cpu);
+        }
+    }
+    for (size_t node = 0; node < node_cpus_.size(); ++node) {
+        for (int cpu : node_cpus_[node]) {
+            if (static_cast<size_t>(cpu) >= cpu_node_.size()) cpu_node_.resize(cpu + 1, 0);
+            cpu_node_[cpu] = node;
+        }
+    }
+}
+
+size_t NumaTopology::nodeOfCpu(int cpu) const {
+    return (cpu >= 0 && static_cast<size_t>(cpu) < cpu_node_.size()) ? cpu_node_[cpu] : 0;
+}
+
+size_t NumaTopology::currentNode() const {
+    return numNodes() > 1 ? nodeOfCpu(sched_getcpu()) : 0;
+}
+
+int NumaTopology::cpuForWorker(size_t worker, Pinning pinning) const {
+    if (pinning == Pinning::NONE || node_cpus_[0].empty()) {
+        return -1;
+    }
+    size_t total = 0;
+    for (const auto& cpus : node_cpus_) total += cpus.size();
+    size_t slot = worker % total;
+
+    if (pinning == Pinning::COMPACT) {
+        for (const auto& cpus : node_cpus_) {
+            if (slot < cpus.size()) return cpus[slot];
+            slot -= cpus.size();
+        }
+    }
+    // SCATTER: node = slot % nodes, skipping nodes that ran out of CPUs
+    std::vector<size_t> used(numNodes(), 0);
+    for (size_t node = 0;; node = (node + 1) % numNodes()) {
+        if (used[node] == node_cpus_[node].size()) continue;
+        if (slot == 0) return node_cpus_[node][used[node]];
+        ++used[node];
+        --slot;
+    }
+}
+
+bool NumaTopology::pinCurrentThread(const std::vector<int>& cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+    }
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+NumaTopology::Counters NumaTopology::readCounters() {
+    namespace fs = std::filesystem;
+    Counters counters;
+    std::error_code error;
+    for (const auto& entry : fs::directory_iterator(kNodeDir, error)) {
+        std::ifstream in(entry.path() / "numastat");
+        if (!in) continue;
+        std::string key;
+        uint64_t value = 0;
+        while (in >> key >> value) {
+            if (key == "numa_hit") counters.numa_hit += value;
+            else if (key == "numa_miss") counters.numa_miss += value;
+            else if (key == "local_node") counters.local_node += value;
+            else if (key == "other_node") counters.other_node += value;
+        }
+        counters.available = true;
+    }
+    return counters;
+}
+
+std::vector<size_t> NumaTopology::pagesPerNode(const void* data, size_t bytes) const {
+    std::vector<size_t> pages(numNodes(), 0);
+    if (!data || bytes == 0) {
+        return pages;
+    }
+    const uintptr_t page_size = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    uintptr_t first = reinterpret_cast<uintptr_t>(data) / page_size * page_size;
+    uintptr_t end = reinterpret_cast<uintptr_t>(data) + bytes;
+
+    // move_pages without target nodes only reports where each page lives
+    const size_t batch = 4096;
+    std::vector<void*> addresses;
+    std::vector<int> status;
+    for (uintptr_t page = first; page < end;) {
+        addresses.clear();
+        for (; page < end && addresses.size() < batch; page += page_size) {
+            addresses.push_back(reinterpret_cast<void*>(page));
+        }
+        status.assign(addresses.size(), -1);
+        if (syscall(SYS_move_pages, 0, addresses.size(), addresses.data(), nullptr, status.data(), 0) != 0) {
+            return pages;
+        }
+        for (int node : status) {
+            auto it = std::find(node_ids_.begin(), node_ids_.end(), node);
+            if (it != node_ids_.end()) ++pages[it - node_ids_.begin()];
+        }
+    }
+    return pages;
+}
+
+NumaTopology::Pinning NumaTopology::parsePinning(const std::string& name) {
+    if (name == "none") return Pinning::NONE;
+    if (name == "compact") return Pinning::COMPACT;
+    if (name == "scatter") return Pinning::SCATTER;
+    throw std::invalid_argument("Unknown pinning " + name + " (none, compact, scatter)");
+}
+
+const char* NumaTopology::pinningName(Pinning pinning) {
+    switch (pinning) {
+        case Pinning::COMPACT: return "compact";
+        case Pinning::SCATTER: return "scatter";
+        default: return "none";
+    }
+}
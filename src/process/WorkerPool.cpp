@@ -0,0 +1,55 @@
+#include "WorkerPool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+size_t WorkerPool::workers(size_t num_items, size_t threads) {
+    return std::min(std::max<size_t>(threads, 1), std::max<size_t>(num_items, 1));
+}
+
+void WorkerPool::run(size_t num_items, size_t threads,
+                     const std::function<void(size_t worker)>& start,
+                     const std::function<void(size_t item, size_t worker)>& fn) {
+    std::atomic<size_t> next_item{0};
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto fail = [&]() {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (!error) error = std::current_exception();
+        next_item = num_items;
+    };
+    auto worker = [&](size_t worker_index) {
+        try {
+            if (start) start(worker_index);
+        } catch (...) {
+            fail();
+            return;
+        }
+        for (size_t item = next_item++; item < num_items; item = next_item++) {
+            try {
+                fn(item, worker_index);
+            } catch (...) {
+                fail();
+            }
+        }
+    };
+
+    size_t pool_size = workers(num_items, threads);
+    if (pool_size == 1) {
+        worker(0);
+    } else {
+        std::vector<std::thread> pool;
+        for (size_t t = 0; t < pool_size; ++t) {
+            pool.emplace_back(worker, t);
+        }
+        for (auto& thread : pool) {
+            thread.join();
+        }
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
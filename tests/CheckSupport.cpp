@@ -0,0 +1,59 @@
+#include "CheckSupport.hpp"
+#include <cstring>
+#include <unistd.h>
+
+std::unique_ptr<CloudConstructor> fullFrameConstructor(const SyntheticScene& scene, const SceneSpec& spec,
+                                                       size_t k_candidates, size_t max_idx_distance) {
+    return std::make_unique<CloudConstructor>(scene.msi.get(), scene.acclp.get(), scene.aux2d.get(),
+                                              k_candidates, max_idx_distance, spec.K, kNumVariables,
+                                              0, spec.H - 1, 0, spec.W - 1);
+}
+
+std::unique_ptr<CloudConstructor> runBatch(const SyntheticScene& scene, const SceneSpec& spec,
+                                           size_t k_candidates, size_t max_idx_distance) {
+    CoutSilencer silencer;
+    auto batch = fullFrameConstructor(scene, spec, k_candidates, max_idx_distance);
+    batch->construct();
+    return batch;
+}
+
+bool sameDonors(const std::string& check, const CloudConstructor& batch, const size_t* indices,
+                const std::vector<char>& mask) {
+    const size_t W_out = batch.outputWidth();
+    const auto& expected = batch.getMappedIndices();
+    for (size_t pixel = 0; pixel < expected.size(); ++pixel) {
+        if ((mask.empty() || mask[pixel]) && indices[pixel] != expected[pixel]) {
+            std::cerr << "[check] " << check << ": mapped_indices differ from the batch run at ("
+                      << pixel / W_out << "," << pixel % W_out << "): " << indices[pixel]
+                      << " != " << expected[pixel] << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool sameProfiles(const std::string& check, const CloudConstructor& batch, const double* profiles,
+                  const std::vector<size_t>& variables, const std::vector<char>& mask) {
+    const size_t H_out = batch.outputHeight(), W_out = batch.outputWidth(), K = batch.verticalLevels();
+    const size_t L = variables.empty() ? batch.numVariables() : variables.size();
+    for (size_t l = 0; l < L; ++l) {
+        size_t batch_l = variables.empty() ? l : variables[l];
+        for (size_t i = 0; i < H_out; ++i) {
+            for (size_t j = 0; j < W_out; ++j) {
+                if (!mask.empty() && !mask[i * W_out + j]) continue;
+                const double* expected = batch.getMappedData().data() + batch.flatIndex(i, j, 0, batch_l);
+                const double* actual = profiles + ((l * H_out + i) * W_out + j) * K;
+                if (std::memcmp(expected, actual, K * sizeof(double)) != 0) {
+                    std::cerr << "[check] " << check << ": profiles differ from the batch run at ("
+                              << i << "," << j << "), variable " << batch_l << std::endl;
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+std::string scratchPath(const std::string& name) {
+    return "/tmp/barker_" + name + "_" + std::to_string(getpid());
+}
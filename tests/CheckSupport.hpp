@@ -0,0 +1,60 @@
+#pragma once
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "SyntheticScene.hpp"
+#include "CloudConstructor.hpp"
+
+// Shared pieces of the regression check: every feature check builds a synthetic
+// scene, runs the exact batch constructor on it and compares its own output
+// against that reference.
+
+const size_t kNumVariables = 13;
+
+struct NamedCheck {
+    std::string name;
+    std::function<bool()> run;
+};
+
+// Redirects std::cout while CloudConstructor logs its progress
+class CoutSilencer {
+public:
+    CoutSilencer() : saved_(std::cout.rdbuf(sink_.rdbuf())) {}
+    ~CoutSilencer() { std::cout.rdbuf(saved_); }
+
+private:
+    std::ostringstream sink_;
+    std::streambuf* saved_;
+};
+
+// Exact constructor over the whole synthetic frame, not run yet
+std::unique_ptr<CloudConstructor> fullFrameConstructor(const SyntheticScene& scene, const SceneSpec& spec,
+                                                       size_t k_candidates, size_t max_idx_distance);
+
+// fullFrameConstructor after construct(), the reference of the feature checks
+std::unique_ptr<CloudConstructor> runBatch(const SyntheticScene& scene, const SceneSpec& spec,
+                                           size_t k_candidates, size_t max_idx_distance);
+
+// Donors [H_out][W_out] of a run against the batch reference, on the pixels of
+// mask (all pixels if empty); the first difference is reported as "[check] <check>: ..."
+bool sameDonors(const std::string& check, const CloudConstructor& batch, const size_t* indices,
+                const std::vector<char>& mask = {});
+
+// Profiles [variable][H_out][W_out][K] of a run against the batch reference, bit for bit.
+// Variable l of the run is batch variable variables[l] (the batch order if empty).
+bool sameProfiles(const std::string& check, const CloudConstructor& batch, const double* profiles,
+                  const std::vector<size_t>& variables = {}, const std::vector<char>& mask = {});
+
+// Path of a scratch file of this process under /tmp
+std::string scratchPath(const std::string& name);
+
+// Feature checks, one table per check source
+std::vector<NamedCheck> sweepChecks();
+std::vector<NamedCheck> incrementalChecks();
+std::vector<NamedCheck> inputChecks();
+std::vector<NamedCheck> searchOptionsChecks();
+std::vector<NamedCheck> zarrChecks();
+std::vector<NamedCheck> libraryChecks();
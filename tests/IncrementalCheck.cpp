@@ -0,0 +1,199 @@
+#include "CheckSupport.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include "IncrementalConstructor.hpp"
+
+namespace {
+
+// Along-track slices of a synthetic scene, as delivered in near-real time
+std::unique_ptr<MSI_RGR_Data> sliceMSI(const MSI_RGR_Data& msi, size_t begin, size_t end) {
+    auto slice = std::make_unique<MSI_RGR_Data>();
+    auto rows = [begin, end](const auto& field) { return field.sliceRows(begin, end); };
+    // Radiance is band-major, so its rows are not contiguous
+    size_t B = msi.bands(), W = msi.width();
+    std::vector<double> radiance;
+    radiance.reserve(B * (end - begin) * W);
+    for (size_t b = 0; b < B; ++b) {
+        const double* first = &msi.radiance(b, begin, 0);
+        radiance.insert(radiance.end(), first, first + (end - begin) * W);
+    }
+    slice->radiance = ArrayView3D<double>::fromVector(std::move(radiance), {B, end - begin, W});
+    slice->longitude = rows(msi.longitude);
+    slice->latitude = rows(msi.latitude);
+    slice->mu0 = rows(msi.mu0);
+    slice->phi0 = rows(msi.phi0);
+    slice->surface_type = rows(msi.surface_type);
+    return slice;
+}
+
+std::unique_ptr<AC_CLP_Data> sliceACCLP(const AC_CLP_Data& acclp, size_t begin, size_t end) {
+    auto slice = std::make_unique<AC_CLP_Data>();
+    auto points = [begin, end](const auto& field) { return field.sliceRows(begin, end); };
+    slice->cloud_effective_radius1 = points(acclp.cloud_effective_radius1);
+    slice->cloud_effective_radius2 = points(acclp.cloud_effective_radius2);
+    slice->cloud_water_content1 = points(acclp.cloud_water_content1);
+    slice->cloud_water_content2 = points(acclp.cloud_water_content2);
+    slice->cloud_phase1 = points(acclp.cloud_phase1);
+    slice->cloud_phase2 = points(acclp.cloud_phase2);
+    slice->radar_lidar_flag = points(acclp.radar_lidar_flag);
+    slice->height = points(acclp.height);
+    slice->longitude = points(acclp.longitude);
+    slice->latitude = points(acclp.latitude);
+    return slice;
+}
+
+std::unique_ptr<AUX__2D_Data> sliceAUX(const AUX__2D_Data& aux2d, size_t begin, size_t end) {
+    auto slice = std::make_unique<AUX__2D_Data>();
+    auto points = [begin, end](const auto& field) { return field.sliceRows(begin, end); };
+    slice->ozoneMassMixingRatio = points(aux2d.ozoneMassMixingRatio);
+    slice->pressure = points(aux2d.pressure);
+    slice->specificHumidity = points(aux2d.specificHumidity);
+    slice->temperature = points(aux2d.temperature);
+    slice->height = points(aux2d.height);
+    slice->surfacePressure = points(aux2d.surfacePressure);
+    slice->totalColumnOzone = points(aux2d.totalColumnOzone);
+    slice->totalColumnWaterVapor = points(aux2d.totalColumnWaterVapor);
+    slice->day_night_flag = points(aux2d.day_night_flag);
+    slice->land_water_flag = points(aux2d.land_water_flag);
+    slice->longitude = points(aux2d.longitude);
+    slice->latitude = points(aux2d.latitude);
+    return slice;
+}
+
+// Pixels whose batch search finds an admissible donor among its k spectrally
+// nearest AC_CLP points; elsewhere it falls back to the closest point of the
+// whole track, which a streaming search cannot reproduce
+std::vector<char> admissibleWithinK(const SyntheticScene& scene, size_t k_candidates, size_t max_idx_distance) {
+    const MSI_RGR_Data& msi = *scene.msi;
+    size_t H = msi.height(), W = msi.width(), N = scene.acclp->longitude.size();
+    std::vector<KDTreeSearcherCoord::Point> msi_coords;
+    for (size_t i = 0; i < H; ++i) {
+        for (size_t j = 0; j < W; ++j) {
+            msi_coords.push_back({msi.longitude[i][j], msi.latitude[i][j]});
+        }
+    }
+    KDTreeSearcherCoord msi_tree(msi_coords);
+    auto pixelState = [&msi](size_t i, size_t j) {
+        return DonorSelector::PixelState{i, msi.mu0[i][j], msi.phi0[i][j], msi.surface_type[i][j]};
+    };
+    std::vector<DonorSelector::PixelState> donor_states;
+    for (size_t n = 0; n < N; ++n) {
+        size_t nearest = msi_tree.findNearest({scene.acclp->longitude[n], scene.acclp->latitude[n]}).first;
+        donor_states.push_back(pixelState(nearest / W, nearest % W));
+    }
+    KDTreeSearcherBand spectral_tree(scene.acclp->radiance);
+
+    std::vector<char> found(H * W, 0);
+    for (size_t i = 0; i < H; ++i) {
+        for (size_t j = 0; j < W; ++j) {
+            KDTreeSearcherBand::Spectrum query;
+            for (size_t b = 0; b < msi.bands(); ++b) query[b] = std::log(msi.radianceAt(i, j, b));
+            for (const auto& candidate : spectral_tree.findKNearest(query, k_candidates)) {
+                if (DonorSelector::isAdmissible(pixelState(i, j), donor_states[candidate.first], max_idx_distance, 30.0, 30.0)) {
+                    found[i * W + j] = 1;
+                    break;
+                }
+            }
+        }
+    }
+    return found;
+}
+
+// Incremental mode fed in along-track segments must reproduce the batch run
+// wherever the batch search finds an admissible donor within its k candidates,
+// for the selected variables, and must emit rows before the end of the stream
+bool checkIncrementalEquivalence(const SceneSpec& spec, size_t k_candidates, size_t max_idx_distance,
+                                 size_t segment_rows, size_t settle_margin, const std::vector<size_t>& variables,
+                                 const std::vector<size_t>& surface_variables) {
+    SyntheticScene scene = makeSyntheticScene(spec);
+    const size_t num_pixels = spec.H * spec.W;
+    const size_t L = variables.size(), S = surface_variables.size();
+
+    std::vector<size_t> indices(num_pixels, std::numeric_limits<size_t>::max());
+    std::vector<double> profiles(L * num_pixels * spec.K);
+    std::vector<double> surface(S * num_pixels);
+    size_t rows_before_finish = 0;
+    size_t rows_total = 0;
+    {
+        CoutSilencer silencer;
+        IncrementalConstructor incremental(
+            [&](const IncrementalConstructor::EmittedRows& rows) {
+                // Rows of every variable plane go to the same rows of the frame
+                const size_t first = rows.first_row * spec.W, count = rows.num_rows * spec.W;
+                std::copy(rows.mapped_indices.begin(), rows.mapped_indices.end(), indices.begin() + first);
+                for (size_t l = 0; l < rows.L; ++l) {
+                    std::copy_n(rows.mapped_data.begin() + l * count * spec.K, count * spec.K,
+                                profiles.begin() + (l * num_pixels + first) * spec.K);
+                }
+                for (size_t s = 0; s < rows.S; ++s) {
+                    std::copy_n(rows.surface.begin() + s * count, count, surface.begin() + s * num_pixels + first);
+                }
+            },
+            k_candidates, max_idx_distance, spec.K, spec.aux_offset, settle_margin);
+        incremental.selectVariables(variables, surface_variables);
+
+        for (size_t begin = 0; begin < spec.H; begin += segment_rows) {
+            size_t end = std::min(begin + segment_rows, spec.H);
+            incremental.appendMSI(sliceMSI(*scene.msi, begin, end));
+            incremental.appendACCLP(sliceACCLP(*scene.acclp, begin, end));
+            incremental.appendAUX(sliceAUX(*scene.aux2d, begin == 0 ? 0 : begin + spec.aux_offset,
+                                           end + spec.aux_offset));
+            incremental.process();
+        }
+        rows_before_finish = incremental.emittedRows();
+        incremental.finish();
+        rows_total = incremental.emittedRows();
+    }
+
+    auto batch = runBatch(scene, spec, k_candidates, max_idx_distance);
+    std::vector<char> compared = admissibleWithinK(scene, k_candidates, max_idx_distance);
+
+    bool ok = true;
+    if (rows_before_finish == 0 || rows_total != spec.H) {
+        std::cerr << "[check] incremental: emitted " << rows_before_finish << " rows before the end, "
+                  << rows_total << " in total" << std::endl;
+        ok = false;
+    }
+    // A check that compares almost nothing would pass trivially
+    if (std::count(compared.begin(), compared.end(), 1) * 2 < static_cast<long>(num_pixels)) {
+        std::cerr << "[check] incremental: batch finds an admissible donor within k for less than half the pixels"
+                  << std::endl;
+        ok = false;
+    }
+    ok = ok && sameDonors("incremental", *batch, indices.data(), compared) &&
+         sameProfiles("incremental", *batch, profiles.data(), variables, compared);
+
+    // Surface fields of the batch donor's AUX point
+    std::vector<double> expected(S);
+    for (size_t pixel = 0; ok && pixel < num_pixels; ++pixel) {
+        if (!compared[pixel]) continue;
+        CloudConstructor::mapSurface(*scene.aux2d, batch->getMappedIndices()[pixel] + spec.aux_offset,
+                                     surface_variables, expected.data());
+        for (size_t s = 0; s < S; ++s) {
+            if (std::memcmp(&expected[s], &surface[s * num_pixels + pixel], sizeof(double)) != 0) {
+                std::cerr << "[check] incremental: surface variable " << s << " differs at pixel " << pixel << std::endl;
+                ok = false;
+                break;
+            }
+        }
+    }
+    return ok;
+}
+
+} // namespace
+
+std::vector<NamedCheck> incrementalChecks() {
+    return {
+        // k covering the whole track with all variables, and k much smaller than the
+        // track with the smallest settle margin and a selection from both products
+        {"incremental_equivalence", [] {
+            return checkIncrementalEquivalence({"incremental", 160, 12, 4, 100, 59}, 160, 10, 7, 2,
+                                               {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12}, {0, 1, 2, 3, 4});
+        }},
+        {"incremental_small_k", [] {
+            return checkIncrementalEquivalence({"incremental", 160, 12, 4, 100, 59}, 8, 10, 7, 0, {2, 6, 9, 12}, {3, 0});
+        }},
+    };
+}
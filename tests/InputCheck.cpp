@@ -0,0 +1,134 @@
+#include "CheckSupport.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+#include <highfive/H5File.hpp>
+#include "MappedDataset.hpp"
+#include "AC_CLP_Reader.hpp"
+#include "AUX__2D_Reader.hpp"
+
+namespace {
+
+// Contiguous native datasets must be memory-mapped, chunked / compressed /
+// converted datasets read through a buffer, with identical values either way
+bool checkMappedRead() {
+    const size_t H = 37, W = 11;
+    std::vector<double> values(H * W);
+    std::vector<int> flags(H * W);
+    for (size_t n = 0; n < H * W; ++n) {
+        values[n] = 0.25 * n - 3.0;
+        flags[n] = static_cast<int>(n % 5);
+    }
+    std::vector<std::vector<double>> rows(H, std::vector<double>(W));
+    std::vector<std::vector<int>> flag_rows(H, std::vector<int>(W));
+    std::vector<std::vector<float>> float_rows(H, std::vector<float>(W));
+    for (size_t i = 0; i < H; ++i) {
+        for (size_t j = 0; j < W; ++j) {
+            rows[i][j] = values[i * W + j];
+            flag_rows[i][j] = flags[i * W + j];
+            float_rows[i][j] = static_cast<float>(values[i * W + j]);
+        }
+    }
+
+    std::string path = scratchPath("mapped_check") + ".h5";
+    {
+        HighFive::File file(path, HighFive::File::Truncate);
+        file.createDataSet("contiguous", rows);
+        HighFive::DataSetCreateProps props;
+        props.add(HighFive::Chunking(std::vector<hsize_t>{8, W}));
+        props.add(HighFive::Deflate(4));
+        file.createDataSet<int>("compressed", HighFive::DataSpace::From(flag_rows), props).write(flag_rows);
+        file.createDataSet("single", float_rows);
+    }
+
+    bool ok = true;
+    {
+        CoutSilencer silencer;
+        HighFive::File file(path, HighFive::File::ReadOnly);
+        auto contiguous = MappedDataset::read<double, 2>(file, "contiguous");
+        auto compressed = MappedDataset::read<int, 2>(file, "compressed");
+        auto single = MappedDataset::read<double, 2>(file, "single");
+        auto tail = contiguous.sliceRows(30, H);
+
+        bool mapping = MappedDataset::enabled();
+        if (contiguous.isMapped() != mapping || compressed.isMapped() || single.isMapped()) {
+            std::cerr << "[check] mapped_read: unexpected mapped / buffered choice" << std::endl;
+            ok = false;
+        }
+        for (size_t i = 0; ok && i < H; ++i) {
+            for (size_t j = 0; j < W; ++j) {
+                if (contiguous[i][j] != values[i * W + j] || compressed(i, j) != flags[i * W + j] ||
+                    single[i][j] != static_cast<float>(values[i * W + j]) ||
+                    (i >= 30 && tail[i - 30][j] != values[i * W + j])) {
+                    std::cerr << "[check] mapped_read: value differs at (" << i << "," << j << ")" << std::endl;
+                    ok = false;
+                    break;
+                }
+            }
+        }
+    }
+    std::remove(path.c_str());
+    return ok;
+}
+
+// Profiles gathered lazily for the selected donors and variables must equal
+// the eagerly mapped ones; only the unique donor rows may be read
+bool checkLazyGather(const SceneSpec& spec, const std::vector<size_t>& variables) {
+    SyntheticScene scene = makeSyntheticScene(spec);
+    size_t N = scene.acclp->longitude.size();
+    std::string prefix = scratchPath("lazy_check");
+    std::string msi_path = prefix + "_msi.h5", acclp_path = prefix + "_acclp.h5", aux_path = prefix + "_aux.h5";
+    writeSyntheticScene(scene, msi_path, acclp_path, aux_path);
+
+    std::vector<std::string> names;
+    for (size_t v : variables) {
+        names.push_back(CloudConstructor::profileVariableNames()[v]);
+    }
+
+    bool ok = true;
+    {
+        auto eager = runBatch(scene, spec, N, 10);
+
+        CoutSilencer silencer;
+        auto acclp = AC_CLP_Reader::readGeometry(acclp_path);
+        auto aux2d = AUX__2D_Reader::readGeometry(aux_path);
+        size_t gathered = 0;
+        CloudConstructor lazy(scene.msi.get(), acclp.get(), aux2d.get(),
+                              N, 10, acclp->vertical_levels, kNumVariables, 0, spec.H - 1, 0, spec.W - 1);
+        lazy.selectVariables(variables);
+        lazy.setProfileLoader([&](const std::vector<size_t>& ac_rows, const std::vector<size_t>& aux_rows) {
+            AC_CLP_Reader::readProfiles(acclp_path, ac_rows, names, *acclp);
+            AUX__2D_Reader::readProfiles(aux_path, aux_rows, names, *aux2d);
+            gathered = ac_rows.size();
+        });
+        lazy.construct();
+
+        std::vector<size_t> donors(eager->getMappedIndices().begin(), eager->getMappedIndices().end());
+        std::sort(donors.begin(), donors.end());
+        donors.erase(std::unique(donors.begin(), donors.end()), donors.end());
+        if (!donors.empty() && donors.back() == std::numeric_limits<size_t>::max()) {
+            donors.pop_back();
+        }
+        if (gathered != donors.size() ||
+            acclp->cloud_effective_radius1.numElements() != (std::count(variables.begin(), variables.end(), 0) ? gathered * spec.K : 0)) {
+            std::cerr << "[check] lazy_gather: gathered " << gathered << " rows for " << donors.size() << " donors" << std::endl;
+            ok = false;
+        }
+        ok = ok && sameDonors("lazy_gather", *eager, lazy.getMappedIndices().data()) &&
+             sameProfiles("lazy_gather", *eager, lazy.getMappedData().data(), variables);
+    }
+    std::remove(msi_path.c_str());
+    std::remove(acclp_path.c_str());
+    std::remove(aux_path.c_str());
+    return ok;
+}
+
+} // namespace
+
+std::vector<NamedCheck> inputChecks() {
+    return {
+        {"mapped_read", [] { return checkMappedRead(); }},
+        // Variables from both products, AUX levels flipped
+        {"lazy_gather", [] { return checkLazyGather({"lazy", 48, 12, 4, 100, 61}, {2, 6, 9, 12}); }},
+    };
+}
@@ -0,0 +1,209 @@
+#include "CheckSupport.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <list>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include "Barker.hpp"
+
+namespace {
+
+// View on a caller-owned copy of src; arrays keeps the copies alive at stable addresses
+template <typename T, size_t Rank>
+ArrayView<T, Rank> borrow(const ArrayView<T, Rank>& src, std::list<std::vector<T>>& arrays) {
+    arrays.emplace_back(src.data(), src.data() + src.numElements());
+    return ArrayView<T, Rank>::fromMemory(arrays.back().data(), src.shape(), nullptr);
+}
+
+// Shapes of the datasets written, and the values of the int ones
+class RecordingWriter : public DatasetWriter {
+public:
+    using DatasetWriter::writeDataset;
+    void writeDataset(const std::string& name, const size_t*, const std::vector<size_t>& shape, size_t) override {
+        shapes[name] = shape;
+    }
+    void writeDataset(const std::string& name, const double*, const std::vector<size_t>& shape, size_t) override {
+        shapes[name] = shape;
+    }
+    void writeDataset(const std::string& name, const int* data, const std::vector<size_t>& shape, size_t) override {
+        shapes[name] = shape;
+        ints[name].assign(data, data + shape[0] * shape[1]);
+    }
+
+    std::map<std::string, std::vector<size_t>> shapes;
+    std::map<std::string, std::vector<int>> ints;
+};
+
+// The library on caller-owned input arrays and output buffers must give the
+// CloudConstructor results without touching the pages of an uninitialised
+// buffer before run(), its tiles must cover every output pixel once, and
+// donors whose AUX row is past the AUX track must be refused
+bool checkLibraryAPI(const SceneSpec& spec) {
+    SyntheticScene scene = makeSyntheticScene(spec);
+    size_t N = scene.acclp->longitude.size();
+    const size_t i_min = 5, i_max = spec.H - 4;
+    const size_t H_out = i_max - i_min + 1;
+
+    std::list<std::vector<double>> doubles;
+    std::list<std::vector<int>> ints;
+    MSI_RGR_Data msi;
+    msi.radiance = borrow(scene.msi->radiance, doubles);
+    msi.longitude = borrow(scene.msi->longitude, doubles);
+    msi.latitude = borrow(scene.msi->latitude, doubles);
+    msi.mu0 = borrow(scene.msi->mu0, doubles);
+    msi.phi0 = borrow(scene.msi->phi0, doubles);
+    msi.surface_type = borrow(scene.msi->surface_type, ints);
+    AC_CLP_Data acclp;
+    acclp.cloud_effective_radius1 = borrow(scene.acclp->cloud_effective_radius1, doubles);
+    acclp.cloud_effective_radius2 = borrow(scene.acclp->cloud_effective_radius2, doubles);
+    acclp.cloud_water_content1 = borrow(scene.acclp->cloud_water_content1, doubles);
+    acclp.cloud_water_content2 = borrow(scene.acclp->cloud_water_content2, doubles);
+    acclp.cloud_phase1 = borrow(scene.acclp->cloud_phase1, ints);
+    acclp.cloud_phase2 = borrow(scene.acclp->cloud_phase2, ints);
+    acclp.radar_lidar_flag = borrow(scene.acclp->radar_lidar_flag, ints);
+    acclp.height = borrow(scene.acclp->height, doubles);
+    acclp.longitude = borrow(scene.acclp->longitude, doubles);
+    acclp.latitude = borrow(scene.acclp->latitude, doubles);
+    acclp.vertical_levels = scene.acclp->vertical_levels;
+    AUX__2D_Data aux2d;
+    aux2d.ozoneMassMixingRatio = borrow(scene.aux2d->ozoneMassMixingRatio, doubles);
+    aux2d.pressure = borrow(scene.aux2d->pressure, doubles);
+    aux2d.specificHumidity = borrow(scene.aux2d->specificHumidity, doubles);
+    aux2d.temperature = borrow(scene.aux2d->temperature, doubles);
+    aux2d.height = borrow(scene.aux2d->height, doubles);
+    aux2d.surfacePressure = borrow(scene.aux2d->surfacePressure, doubles);
+    aux2d.totalColumnOzone = borrow(scene.aux2d->totalColumnOzone, doubles);
+    aux2d.totalColumnWaterVapor = borrow(scene.aux2d->totalColumnWaterVapor, doubles);
+    aux2d.day_night_flag = borrow(scene.aux2d->day_night_flag, ints);
+    aux2d.land_water_flag = borrow(scene.aux2d->land_water_flag, ints);
+    aux2d.longitude = borrow(scene.aux2d->longitude, doubles);
+    aux2d.latitude = borrow(scene.aux2d->latitude, doubles);
+
+    CoutSilencer silencer;
+    CloudConstructor reference(scene.msi.get(), scene.acclp.get(), scene.aux2d.get(),
+                               N, 10, spec.K, kNumVariables, i_min, i_max, 0, spec.W - 1);
+    reference.construct();
+
+    BarkerProcessor::Options options;
+    options.k_candidates = N;
+    options.max_idx_distance = 10;
+    options.aux_offset = spec.aux_offset;
+    options.i_min = i_min;
+    options.i_max = i_max;
+    options.search.tile_size = 5;
+    options.search.threads = 3;
+    BarkerProcessor processor(msi, acclp, aux2d, options);
+
+    std::vector<size_t> mapped_indices(processor.mappedIndicesSize());
+    FirstTouchVector<double> profiles(processor.profilesSize());
+    std::vector<double> surface(processor.surfaceSize());
+    std::vector<int> covered(mapped_indices.size(), 0);
+    // Left to the workers: no page of the profiles is resident before run()
+    auto residentPages = [&profiles]() {
+        auto pages = NumaTopology::system().pagesPerNode(profiles.data(), profiles.size() * sizeof(double));
+        return std::accumulate(pages.begin(), pages.end(), size_t(0));
+    };
+    size_t pages_before_run = residentPages();
+    std::mutex covered_mutex;
+    BarkerProcessor::Buffers buffers;
+    buffers.mapped_indices = mapped_indices.data();
+    buffers.profiles = profiles.data();
+    buffers.surface = surface.data();
+    processor.run(buffers, [&](const BarkerProcessor::Tile& tile) {
+        std::lock_guard<std::mutex> lock(covered_mutex);
+        for (size_t i = tile.row; i < tile.row + tile.rows; ++i) {
+            for (size_t j = tile.col; j < tile.col + tile.cols; ++j) {
+                ++covered[i * spec.W + j];
+            }
+        }
+    });
+
+    bool ok = true;
+    if (pages_before_run != 0 || residentPages() == 0) {
+        std::cerr << "[check] library_api: " << pages_before_run << " pages of the profiles touched before run()"
+                  << std::endl;
+        ok = false;
+    }
+    if (processor.outputHeight() != H_out || processor.mappedIndices() != mapped_indices.data() ||
+        std::count(covered.begin(), covered.end(), 1) != static_cast<long>(covered.size())) {
+        std::cerr << "[check] library_api: tiles do not cover every pixel once" << std::endl;
+        ok = false;
+    }
+    ok = ok && profiles.size() == reference.getMappedData().size() &&
+         sameDonors("library_api", reference, mapped_indices.data()) &&
+         sameProfiles("library_api", reference, profiles.data());
+
+    const size_t plane = H_out * spec.W;
+    for (size_t pixel = 0; ok && pixel < plane; ++pixel) {
+        size_t ac_idx = mapped_indices[pixel];
+        double expected[] = {std::numeric_limits<double>::quiet_NaN(), std::numeric_limits<double>::quiet_NaN(),
+                             std::numeric_limits<double>::quiet_NaN(), std::numeric_limits<double>::quiet_NaN(),
+                             std::numeric_limits<double>::quiet_NaN()};
+        if (ac_idx != std::numeric_limits<size_t>::max()) {
+            size_t aux_idx = ac_idx + spec.aux_offset;
+            expected[0] = scene.aux2d->surfacePressure[aux_idx];
+            expected[1] = scene.aux2d->totalColumnOzone[aux_idx];
+            expected[2] = scene.aux2d->totalColumnWaterVapor[aux_idx];
+            expected[3] = scene.aux2d->day_night_flag[aux_idx];
+            expected[4] = scene.aux2d->land_water_flag[aux_idx];
+        }
+        for (size_t s = 0; s < 5; ++s) {
+            if (std::memcmp(&expected[s], &surface[s * plane + pixel], sizeof(double)) != 0) {
+                std::cerr << "[check] library_api: " << processor.surfaceVariables()[s] << " differs at pixel "
+                          << pixel << std::endl;
+                ok = false;
+                break;
+            }
+        }
+    }
+
+    // write(): every selected variable with its shape, flags as int
+    RecordingWriter recorder;
+    processor.write(recorder);
+    std::vector<size_t> pixel_shape = {H_out, spec.W};
+    bool written = recorder.shapes.size() == 3 + processor.profileVariables().size() + processor.surfaceVariables().size() &&
+                   recorder.shapes["mapped_indices"] == pixel_shape && recorder.shapes["latitude"] == pixel_shape;
+    for (const auto& name : processor.profileVariables()) {
+        written = written && recorder.shapes[name] == std::vector<size_t>({H_out, spec.W, spec.K});
+    }
+    for (size_t pixel = 0; written && pixel < plane; ++pixel) {
+        written = recorder.ints["land_water_flag"][pixel] == (std::isnan(surface[4 * plane + pixel])
+                      ? -1 : static_cast<int>(surface[4 * plane + pixel]));
+    }
+    if (!written) {
+        std::cerr << "[check] library_api: write() datasets differ from the run" << std::endl;
+        ok = false;
+    }
+
+    // An AUX track shorter than AC_CLP + offset is refused before any AUX row is read
+    BarkerProcessor::Options short_aux = options;
+    short_aux.aux_offset = aux2d.longitude.size() - N + 1;
+    bool refused = false;
+    try {
+        BarkerProcessor rejected(msi, acclp, aux2d, short_aux);
+    } catch (const std::out_of_range&) {
+        refused = true;
+    }
+    reference.setAuxOffset(short_aux.aux_offset);
+    try {
+        reference.construct();
+        refused = false;
+    } catch (const std::out_of_range&) {
+    }
+    if (!refused) {
+        std::cerr << "[check] library_api: AUX index past the AUX track not refused" << std::endl;
+        ok = false;
+    }
+    return ok;
+}
+
+} // namespace
+
+std::vector<NamedCheck> libraryChecks() {
+    return {
+        {"library_api", [] { return checkLibraryAPI({"library", 40, 12, 4, 100, 71}); }},
+    };
+}
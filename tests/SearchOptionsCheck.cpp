@@ -0,0 +1,105 @@
+#include "CheckSupport.hpp"
+#include <cstdio>
+#include <fstream>
+#include <unistd.h>
+#include "Autotuner.hpp"
+
+namespace {
+
+// Every search configuration (leaf size, brute force, tiles, threads, pinning,
+// kd-tree replicas) must give the donors of the default one, and the autotuner
+// must reuse its cached choice unless it exceeds the thread cap
+bool checkSearchOptions(const SceneSpec& spec) {
+    SyntheticScene scene = makeSyntheticScene(spec);
+    size_t N = scene.acclp->longitude.size();
+    auto reference = runBatch(scene, spec, 20, 40);
+
+    CoutSilencer silencer;
+    auto run = fullFrameConstructor(scene, spec, 20, 40);
+    CloudConstructor& constructor = *run;
+    bool ok = true;
+    std::vector<CloudConstructor::SearchOptions> configurations(6);
+    configurations[0].leaf_size = 3;
+    configurations[1].brute_force = true;
+    configurations[2].tile_size = 5;
+    configurations[2].threads = 3;
+    configurations[3].leaf_size = 64;
+    configurations[3].tile_size = 1;
+    configurations[3].threads = 4;
+    configurations[4].threads = 3;
+    configurations[4].pinning = NumaTopology::Pinning::COMPACT;
+    configurations[4].numa_replicas = true;
+    configurations[5].tile_size = 7;
+    configurations[5].threads = 2;
+    configurations[5].pinning = NumaTopology::Pinning::SCATTER;
+    configurations[5].numa_replicas = true;
+    for (const auto& options : configurations) {
+        constructor.setSearchOptions(options);
+        constructor.construct();
+        std::string name = "search_options leaf " + std::to_string(options.leaf_size) +
+                           (options.brute_force ? " brute" : "") + ", tile " + std::to_string(options.tile_size) +
+                           ", threads " + std::to_string(options.threads) + ", pinning " +
+                           NumaTopology::pinningName(options.pinning) + (options.numa_replicas ? " with replicas" : "");
+        ok = sameDonors(name, *reference, constructor.getMappedIndices().data()) &&
+             sameProfiles(name, *reference, constructor.getMappedData().data()) && ok;
+    }
+
+    std::string cache = scratchPath("autotune_check") + ".txt";
+    Autotuner tuner(cache, 256, 2);
+    auto tuned = tuner.tune(constructor, N, 20);
+    auto cached = tuner.tune(constructor, N, 20);
+    if (tuned.from_cache || !cached.from_cache || cached.shape_class != tuned.shape_class ||
+        cached.options.leaf_size != tuned.options.leaf_size || cached.options.brute_force != tuned.options.brute_force ||
+        cached.options.tile_size != tuned.options.tile_size || cached.options.threads != tuned.options.threads) {
+        std::cerr << "[check] search_options: autotune cache round trip failed" << std::endl;
+        ok = false;
+    }
+    // A cached choice above the thread cap is tuned again; the cache is replaced by rename
+    std::ofstream(cache, std::ios::trunc) << tuned.host << " " << tuned.shape_class << " kd 10 32 3\n";
+    auto capped = tuner.tune(constructor, N, 20);
+    if (capped.from_cache || capped.options.threads > 2 ||
+        std::ifstream(cache + ".tmp." + Autotuner::hostName() + "." + std::to_string(getpid()))) {
+        std::cerr << "[check] search_options: autotune thread cap or cache replacement failed" << std::endl;
+        ok = false;
+    }
+    constructor.construct();
+    ok = sameDonors("search_options autotuned", *reference, constructor.getMappedIndices().data()) && ok;
+    std::remove(cache.c_str());
+    return ok;
+}
+
+// Multiresolution donors must not depend on the threads and tiles that take
+// the grid points and blocks
+bool checkMultiresolutionThreads(const SceneSpec& spec, size_t block_size) {
+    SyntheticScene scene = makeSyntheticScene(spec);
+    CoutSilencer silencer;
+    CloudConstructor::MultiresolutionOptions multires;
+    multires.block_size = block_size;
+    auto serial = fullFrameConstructor(scene, spec, 64, 100);
+    auto stats = serial->constructMultiresolution(multires);
+
+    auto parallel = fullFrameConstructor(scene, spec, 64, 100);
+    CloudConstructor::SearchOptions options;
+    options.tile_size = 5;
+    options.threads = 4;
+    options.numa_replicas = true;
+    parallel->setSearchOptions(options);
+    auto parallel_stats = parallel->constructMultiresolution(multires);
+    if (parallel_stats.searched_pixels != stats.searched_pixels) {
+        std::cerr << "[check] multires_threads: searched " << parallel_stats.searched_pixels << " pixels, "
+                  << stats.searched_pixels << " serially" << std::endl;
+        return false;
+    }
+    return sameDonors("multires_threads", *serial, parallel->getMappedIndices().data()) &&
+           sameProfiles("multires_threads", *serial, parallel->getMappedData().data());
+}
+
+} // namespace
+
+std::vector<NamedCheck> searchOptionsChecks() {
+    return {
+        {"search_options", [] { return checkSearchOptions({"search", 64, 16, 4, 100, 67}); }},
+        // Flat cloud decks, so that blocks share donors
+        {"multires_threads", [] { return checkMultiresolutionThreads({"multires", 64, 24, 6, 100, 11, 0.01, 3}, 4); }},
+    };
+}
@@ -0,0 +1,45 @@
+#include "CheckSupport.hpp"
+
+namespace {
+
+// Parameter sets of the sweep check: k, max_idx_distance, delta_mu0, delta_phi0
+std::vector<DonorSelector::Criteria> sweepCriteria() {
+    return {
+        {20, 12, 30.0, 30.0},
+        { 5, 12, 30.0, 30.0},
+        {40,  4, 30.0, 30.0},
+        {20, 12, 10.0, 30.0},
+        {20, 12, 30.0,  2.0},
+        {60, 30, 60.0, 60.0},
+    };
+}
+
+// Every sweep layer must equal a standalone run with the same parameters
+bool checkSweepEquivalence(const SceneSpec& spec) {
+    SyntheticScene scene = makeSyntheticScene(spec);
+    std::vector<DonorSelector::Criteria> criteria = sweepCriteria();
+    size_t num_pixels = spec.H * spec.W;
+
+    CoutSilencer silencer;
+    auto sweep = fullFrameConstructor(scene, spec, 100, 400);
+    sweep->constructSweep(criteria);
+    const auto& layers = sweep->getSweepIndices();
+
+    bool ok = layers.size() == criteria.size() * num_pixels;
+    for (size_t c = 0; ok && c < criteria.size(); ++c) {
+        auto single = fullFrameConstructor(scene, spec, criteria[c].k_candidates, criteria[c].max_idx_distance);
+        single->setAngleThresholds(criteria[c].delta_mu0, criteria[c].delta_phi0);
+        single->construct();
+        ok = sameDonors("sweep_equivalence layer " + std::to_string(c), *single, layers.data() + c * num_pixels);
+    }
+    return ok;
+}
+
+} // namespace
+
+std::vector<NamedCheck> sweepChecks() {
+    return {
+        // SceneSpec: name, H, W, K, aux_offset, seed
+        {"sweep_equivalence", [] { return checkSweepEquivalence({"small", 48, 16, 6, 100, 11}); }},
+    };
+}
@@ -0,0 +1,221 @@
+#include "SyntheticScene.hpp"
+#include <highfive/H5File.hpp>
+#include <cmath>
+
+namespace {
+
+template <typename T, size_t Rank>
+void writeView(HighFive::File& file, const std::string& name, const ArrayView<T, Rank>& view) {
+    std::vector<size_t> dims(view.shape().begin(), view.shape().end());
+    file.createDataSet<T>(name, HighFive::DataSpace(dims)).write_raw(view.data());
+}
+
+// SplitMix64: small, portable and fully deterministic across compilers
+class SplitMix64 {
+public:
+    explicit SplitMix64(uint64_t seed) : state_(seed) {}
+
+    uint64_t next() {
+        uint64_t z = (state_ += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    // Uniform in [0, 1)
+    double uniform() { return static_cast<double>(next() >> 11) * 0x1.0p-53; }
+
+    int integer(int n) { return static_cast<int>(next() % static_cast<uint64_t>(n)); }
+
+private:
+    uint64_t state_;
+};
+
+struct Blob {
+    double ci, cj, radius, amplitude;
+};
+
+// Geolocation of a (fractional) MSI pixel position
+double pixelLongitude(double i, double j) { return 130.0 + 0.01 * j + 0.002 * i; }
+double pixelLatitude(double i, double j)  { return 20.0 + 0.01 * i - 0.001 * j; }
+
+} // namespace
+
+SyntheticScene makeSyntheticScene(const SceneSpec& spec) {
+    const size_t H = spec.H;
+    const size_t W = spec.W;
+    const size_t K = spec.K;
+    const size_t B = 7;
+    const size_t N = H;                     // one AC point per MSI row
+    const size_t M = N + spec.aux_offset;   // AUX starts aux_offset points earlier
+
+    SplitMix64 rng(spec.seed);
+    SyntheticScene scene;
+
+    // MSI_RGR //
+    auto msi = std::make_unique<MSI_RGR_Data>();
+    std::vector<Blob> blobs(4 + H / 16);
+    for (auto& blob : blobs) {
+        blob.ci = rng.uniform() * H;
+        blob.cj = rng.uniform() * W;
+        blob.radius = 2.0 + rng.uniform() * 6.0;
+        blob.amplitude = 0.5 + rng.uniform() * 1.5;
+    }
+    std::vector<double> band_base(B), band_gain(B);
+    for (size_t b = 0; b < B; ++b) {
+        band_base[b] = -1.0 + 0.3 * b;
+        band_gain[b] = 0.4 + rng.uniform();
+    }
+
+    std::vector<double> radiance(B * H * W);
+    std::vector<double> longitude(H * W), latitude(H * W), mu0(H * W), phi0(H * W);
+    std::vector<int> surface_type(H * W);
+    for (size_t i = 0; i < H; ++i) {
+        for (size_t j = 0; j < W; ++j) {
+            size_t p = i * W + j;
+            double cloud = 0.0;
+            for (const auto& blob : blobs) {
+                double di = (i - blob.ci) / blob.radius;
+                double dj = (j - blob.cj) / blob.radius;
+                cloud += blob.amplitude * std::exp(-(di * di + dj * dj));
+            }
+            if (spec.cloud_levels > 0) {
+                cloud = std::floor(cloud * spec.cloud_levels) / spec.cloud_levels;
+            }
+            for (size_t b = 0; b < B; ++b) {
+                double noise = spec.noise * (rng.uniform() - 0.5);
+                radiance[b * H * W + p] = std::exp(band_base[b] + band_gain[b] * cloud + noise);
+            }
+            longitude[p] = pixelLongitude(i, j);
+            latitude[p] = pixelLatitude(i, j);
+            mu0[p] = 20.0 + 1.5 * i + 0.1 * j;
+            phi0[p] = 120.0 + 0.5 * i + 2.0 * (rng.uniform() - 0.5);
+            surface_type[p] = ((i / 8 + j / 5) % 3 == 0) ? 1 : 0;
+        }
+    }
+    msi->radiance = ArrayView3D<double>::fromVector(std::move(radiance), {B, H, W});
+    msi->longitude = ArrayView2D<double>::fromVector(std::move(longitude), {H, W});
+    msi->latitude = ArrayView2D<double>::fromVector(std::move(latitude), {H, W});
+    msi->mu0 = ArrayView2D<double>::fromVector(std::move(mu0), {H, W});
+    msi->phi0 = ArrayView2D<double>::fromVector(std::move(phi0), {H, W});
+    msi->surface_type = ArrayView2D<int>::fromVector(std::move(surface_type), {H, W});
+
+    // AC_CLP //
+    auto acclp = std::make_unique<AC_CLP_Data>();
+    std::vector<double> ac_longitude(N), ac_latitude(N);
+    std::vector<double> radius1(N * K), radius2(N * K), water1(N * K), water2(N * K), ac_height(N * K);
+    std::vector<int> phase1(N * K), phase2(N * K), flag(N * K);
+    for (size_t n = 0; n < N; ++n) {
+        // Track wanders a little across-track; jitter stays inside the pixel
+        double track_j = std::round(W / 2.0 + 2.0 * std::sin(n / 7.0));
+        double fi = n + 0.5 * (rng.uniform() - 0.5);
+        double fj = track_j + 0.5 * (rng.uniform() - 0.5);
+        ac_longitude[n] = pixelLongitude(fi, fj);
+        ac_latitude[n] = pixelLatitude(fi, fj);
+        for (size_t k = 0; k < K; ++k) {
+            size_t q = n * K + k;
+            radius1[q] = 5.0 + 20.0 * rng.uniform();
+            radius2[q] = 5.0 + 20.0 * rng.uniform();
+            water1[q] = 1e-3 * rng.uniform();
+            water2[q] = 1e-3 * rng.uniform();
+            phase1[q] = rng.integer(4);
+            phase2[q] = rng.integer(4);
+            flag[q] = rng.integer(4);
+            ac_height[q] = 1000.0 * (K - k) + 10.0 * rng.uniform();
+        }
+    }
+    acclp->longitude = ArrayView1D<double>::fromVector(std::move(ac_longitude), {N});
+    acclp->latitude = ArrayView1D<double>::fromVector(std::move(ac_latitude), {N});
+    acclp->cloud_effective_radius1 = ArrayView2D<double>::fromVector(std::move(radius1), {N, K});
+    acclp->cloud_effective_radius2 = ArrayView2D<double>::fromVector(std::move(radius2), {N, K});
+    acclp->cloud_water_content1 = ArrayView2D<double>::fromVector(std::move(water1), {N, K});
+    acclp->cloud_water_content2 = ArrayView2D<double>::fromVector(std::move(water2), {N, K});
+    acclp->cloud_phase1 = ArrayView2D<int>::fromVector(std::move(phase1), {N, K});
+    acclp->cloud_phase2 = ArrayView2D<int>::fromVector(std::move(phase2), {N, K});
+    acclp->radar_lidar_flag = ArrayView2D<int>::fromVector(std::move(flag), {N, K});
+    acclp->height = ArrayView2D<double>::fromVector(std::move(ac_height), {N, K});
+    acclp->vertical_levels = K;
+
+    // AUX_2D //
+    auto aux2d = std::make_unique<AUX__2D_Data>();
+    std::vector<double> ozone(M * K), pressure(M * K), humidity(M * K), temperature(M * K), aux_height(M * K);
+    std::vector<double> surface_pressure(M), column_ozone(M), column_water(M), aux_longitude(M), aux_latitude(M);
+    std::vector<int> day_night(M), land_water(M);
+    for (size_t m = 0; m < M; ++m) {
+        for (size_t k = 0; k < K; ++k) {
+            // AUX profiles are stored bottom-up
+            size_t q = m * K + k;
+            ozone[q] = 1e-7 * (1.0 + rng.uniform());
+            pressure[q] = 100000.0 - 8000.0 * k + 50.0 * rng.uniform();
+            humidity[q] = 1e-2 * rng.uniform();
+            temperature[q] = 290.0 - 6.5 * k + rng.uniform();
+            aux_height[q] = 1000.0 * (k + 1) + 10.0 * rng.uniform();
+        }
+        surface_pressure[m] = 101000.0 + 500.0 * rng.uniform();
+        column_ozone[m] = 6e-3 + 1e-3 * rng.uniform();
+        column_water[m] = 30.0 * rng.uniform();
+        day_night[m] = 1;
+        land_water[m] = rng.integer(2);
+        aux_longitude[m] = pixelLongitude(static_cast<double>(m) - spec.aux_offset, W / 2.0);
+        aux_latitude[m] = pixelLatitude(static_cast<double>(m) - spec.aux_offset, W / 2.0);
+    }
+    aux2d->ozoneMassMixingRatio = ArrayView2D<double>::fromVector(std::move(ozone), {M, K});
+    aux2d->pressure = ArrayView2D<double>::fromVector(std::move(pressure), {M, K});
+    aux2d->specificHumidity = ArrayView2D<double>::fromVector(std::move(humidity), {M, K});
+    aux2d->temperature = ArrayView2D<double>::fromVector(std::move(temperature), {M, K});
+    aux2d->height = ArrayView2D<double>::fromVector(std::move(aux_height), {M, K});
+    aux2d->surfacePressure = ArrayView1D<double>::fromVector(std::move(surface_pressure), {M});
+    aux2d->totalColumnOzone = ArrayView1D<double>::fromVector(std::move(column_ozone), {M});
+    aux2d->totalColumnWaterVapor = ArrayView1D<double>::fromVector(std::move(column_water), {M});
+    aux2d->day_night_flag = ArrayView1D<int>::fromVector(std::move(day_night), {M});
+    aux2d->land_water_flag = ArrayView1D<int>::fromVector(std::move(land_water), {M});
+    aux2d->longitude = ArrayView1D<double>::fromVector(std::move(aux_longitude), {M});
+    aux2d->latitude = ArrayView1D<double>::fromVector(std::move(aux_latitude), {M});
+
+    scene.msi = std::move(msi);
+    scene.acclp = std::move(acclp);
+    scene.aux2d = std::move(aux2d);
+    return scene;
+}
+
+void writeSyntheticScene(const SyntheticScene& scene, const std::string& msi_path,
+                         const std::string& acclp_path, const std::string& aux_path) {
+    using HighFive::File;
+    {
+        File file(msi_path, File::Truncate);
+        writeView(file, "ScienceData/longitude", scene.msi->longitude);
+        writeView(file, "ScienceData/latitude", scene.msi->latitude);
+        writeView(file, "ScienceData/pixel_values", scene.msi->radiance);
+        writeView(file, "ScienceData/solar_elevation_angle", scene.msi->mu0);
+        writeView(file, "ScienceData/solar_azimuth_angle", scene.msi->phi0);
+        writeView(file, "ScienceData/land_flag", scene.msi->surface_type);
+    }
+    {
+        File file(acclp_path, File::Truncate);
+        writeView(file, "ScienceData/Geo/longitude", scene.acclp->longitude);
+        writeView(file, "ScienceData/Geo/latitude", scene.acclp->latitude);
+        writeView(file, "ScienceData/Geo/height", scene.acclp->height);
+        writeView(file, "ScienceData/Data/cloud_effective_radius1_1km", scene.acclp->cloud_effective_radius1);
+        writeView(file, "ScienceData/Data/cloud_effective_radius2_1km", scene.acclp->cloud_effective_radius2);
+        writeView(file, "ScienceData/Data/cloud_water_content1_1km", scene.acclp->cloud_water_content1);
+        writeView(file, "ScienceData/Data/cloud_water_content2_1km", scene.acclp->cloud_water_content2);
+        writeView(file, "ScienceData/Data/cloud_phase1_1km", scene.acclp->cloud_phase1);
+        writeView(file, "ScienceData/Data/cloud_phase2_1km", scene.acclp->cloud_phase2);
+        writeView(file, "ScienceData/Data/radar_lider_flag_1km", scene.acclp->radar_lidar_flag);
+    }
+    {
+        File file(aux_path, File::Truncate);
+        writeView(file, "ScienceData/Geo/longitude", scene.aux2d->longitude);
+        writeView(file, "ScienceData/Geo/latitude", scene.aux2d->latitude);
+        writeView(file, "ScienceData/Geo/height", scene.aux2d->height);
+        writeView(file, "ScienceData/Geo/day_night_flag", scene.aux2d->day_night_flag);
+        writeView(file, "ScienceData/Geo/land_water_flag", scene.aux2d->land_water_flag);
+        writeView(file, "ScienceData/Data/ozoneMassMixingRatio", scene.aux2d->ozoneMassMixingRatio);
+        writeView(file, "ScienceData/Data/pressure", scene.aux2d->pressure);
+        writeView(file, "ScienceData/Data/specificHumidity", scene.aux2d->specificHumidity);
+        writeView(file, "ScienceData/Data/temperature", scene.aux2d->temperature);
+        writeView(file, "ScienceData/Data/surfacePressure", scene.aux2d->surfacePressure);
+        writeView(file, "ScienceData/Data/totalColumnOzone", scene.aux2d->totalColumnOzone);
+        writeView(file, "ScienceData/Data/totalColumnWaterVapour", scene.aux2d->totalColumnWaterVapor);
+    }
+}
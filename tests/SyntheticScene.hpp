@@ -0,0 +1,31 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <cstdint>
+#include "ObservationDataset.hpp"
+
+// Parameters of a synthetic MSI / AC_CLP / AUX_2D frame
+struct SceneSpec {
+    std::string name;
+    size_t H = 32;          // MSI rows (along-track)
+    size_t W = 12;          // MSI columns (across-track)
+    size_t K = 4;           // Vertical levels
+    size_t aux_offset = 100; // AUX_IDX - ACCLP_IDX at the same point
+    uint64_t seed = 1;
+    double noise = 0.05;     // Amplitude of the per-pixel log-radiance noise
+    size_t cloud_levels = 0; // > 0: cloud field quantized into flat decks
+};
+
+// Deterministic synthetic frame. The AC_CLP track runs along the MSI rows
+// (one point per row) so every AC point maps onto a distinct MSI pixel.
+struct SyntheticScene {
+    std::unique_ptr<MSI_RGR_Data> msi;
+    std::unique_ptr<AC_CLP_Data> acclp;
+    std::unique_ptr<AUX__2D_Data> aux2d;
+};
+
+SyntheticScene makeSyntheticScene(const SceneSpec& spec);
+
+// Writes the frame as MSI_RGR / AC_CLP / AUX_2D product files readable by the readers
+void writeSyntheticScene(const SyntheticScene& scene, const std::string& msi_path,
+                         const std::string& acclp_path, const std::string& aux_path);
@@ -0,0 +1,157 @@
+#include "CheckSupport.hpp"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <zlib.h>
+#include "ZarrWriter.hpp"
+
+namespace {
+
+// Dataset of a Zarr store reassembled from its chunk files; false if a chunk is
+// missing, does not decompress to a full chunk, or its padding is not fill
+template <typename T>
+bool readZarrArray(const std::string& store, const std::string& name, const std::vector<size_t>& shape,
+                   const std::vector<size_t>& chunks, T fill, std::vector<T>& values) {
+    const size_t rank = shape.size();
+    size_t chunk_elements = 1, num_chunks = 1, num_elements = 1;
+    std::vector<size_t> grid(rank);
+    for (size_t d = 0; d < rank; ++d) {
+        grid[d] = (shape[d] + chunks[d] - 1) / chunks[d];
+        chunk_elements *= chunks[d];
+        num_chunks *= grid[d];
+        num_elements *= shape[d];
+    }
+    values.assign(num_elements, fill);
+    std::vector<T> chunk(chunk_elements);
+    std::vector<size_t> grid_index(rank), local(rank);
+    for (size_t c = 0; c < num_chunks; ++c) {
+        std::string key;
+        for (size_t d = rank, rest = c; d-- > 0;) {
+            grid_index[d] = rest % grid[d];
+            rest /= grid[d];
+        }
+        for (size_t d = 0; d < rank; ++d) key += (d ? "." : "") + std::to_string(grid_index[d]);
+        std::ifstream in(store + "/" + name + "/" + key, std::ios::binary);
+        std::string compressed((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        uLongf length = chunk_elements * sizeof(T);
+        if (compressed.empty() ||
+            uncompress(reinterpret_cast<Bytef*>(chunk.data()), &length,
+                       reinterpret_cast<const Bytef*>(compressed.data()), compressed.size()) != Z_OK ||
+            length != chunk_elements * sizeof(T)) {
+            return false;
+        }
+        for (size_t e = 0; e < chunk_elements; ++e) {
+            size_t offset = 0;
+            bool inside = true;
+            for (size_t d = rank, rest = e; d-- > 0;) {
+                local[d] = rest % chunks[d];
+                rest /= chunks[d];
+            }
+            for (size_t d = 0; d < rank; ++d) {
+                size_t global = grid_index[d] * chunks[d] + local[d];
+                inside = inside && global < shape[d];
+                offset = offset * shape[d] + global;
+            }
+            if (inside) {
+                values[offset] = chunk[e];
+            } else if (std::memcmp(&chunk[e], &fill, sizeof(T)) != 0) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Zarr store written by several threads with edge chunks: metadata and the
+// values reassembled from the chunks must match the input
+bool checkZarrStore() {
+    const size_t H = 37, W = 13, K = 5, C = 3;
+    std::vector<double> profile(H * W * K);
+    std::vector<int> flags(H * W);
+    std::vector<size_t> sweep(C * H * W);
+    for (size_t n = 0; n < profile.size(); ++n) {
+        profile[n] = (n % 7 == 0) ? std::numeric_limits<double>::quiet_NaN() : 0.5 * n - 11.0;
+    }
+    for (size_t n = 0; n < flags.size(); ++n) flags[n] = static_cast<int>(n % 3) - 1;
+    for (size_t n = 0; n < sweep.size(); ++n) sweep[n] = (n % 11 == 0) ? std::numeric_limits<size_t>::max() : n * 3;
+
+    std::string store = scratchPath("zarr_check") + ".zarr";
+    bool ok = true;
+    {
+        Zarr_Writer writer(store, 3, 1, 8, 6);
+        writer.writeDataset("profile", profile.data(), {H, W, K});
+        writer.writeDataset("flags", flags, {H, W});
+        writer.writeDataset("sweep", sweep, {C, H, W}, 1);
+        writer.writeDataset("parameters", std::vector<double>{1, 2, 3, 4, 5, 6}, {3, 2}, DatasetWriter::REPLICATED);
+        // Outputs of an empty sweep file: zero-extent arrays without chunk files
+        writer.writeDataset("empty_sweep", std::vector<size_t>{}, {0, H, W}, 1);
+        writer.writeDataset("empty_parameters", std::vector<double>{}, {0, 4}, DatasetWriter::REPLICATED);
+
+        std::ifstream in(store + "/profile/.zarray");
+        std::string metadata((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        std::ifstream sweep_in(store + "/sweep/.zarray");
+        std::string sweep_metadata((std::istreambuf_iterator<char>(sweep_in)), std::istreambuf_iterator<char>());
+        if (!std::filesystem::exists(store + "/.zgroup") ||
+            metadata.find("\"chunks\": [8, 6, 5]") == std::string::npos ||
+            metadata.find("\"shape\": [37, 13, 5]") == std::string::npos ||
+            metadata.find("\"dtype\": \"<f8\"") == std::string::npos ||
+            sweep_metadata.find("\"fill_value\": 18446744073709551615") == std::string::npos ||
+            writer.chunkShape({C, H, W}, 1) != std::vector<size_t>({1, 8, 6}) ||
+            writer.chunkShape({3, 2}, DatasetWriter::REPLICATED) != std::vector<size_t>({3, 2}) ||
+            writer.chunkShape({0, 4}, DatasetWriter::REPLICATED) != std::vector<size_t>({1, 4}) ||
+            writer.chunkShape({0, H, W}, 1) != std::vector<size_t>({1, 8, 6}) ||
+            writer.chunkShape({0, 5}, 2) != std::vector<size_t>({1, 5})) {
+            std::cerr << "[check] zarr_store: unexpected metadata" << std::endl;
+            ok = false;
+        }
+    }
+
+    std::vector<double> profile_read, parameters_read;
+    std::vector<int> flags_read;
+    std::vector<size_t> sweep_read;
+    if (ok && (!readZarrArray(store, "profile", {H, W, K}, {8, 6, K}, std::numeric_limits<double>::quiet_NaN(), profile_read) ||
+               !readZarrArray(store, "flags", {H, W}, {8, 6}, 0, flags_read) ||
+               !readZarrArray(store, "sweep", {C, H, W}, {1, 8, 6}, std::numeric_limits<size_t>::max(), sweep_read) ||
+               !readZarrArray(store, "parameters", {3, 2}, {3, 2}, 0.0, parameters_read))) {
+        std::cerr << "[check] zarr_store: chunk missing, truncated or badly padded" << std::endl;
+        ok = false;
+    }
+    for (const char* name : {"empty_sweep", "empty_parameters"}) {
+        std::ifstream in(store + "/" + name + "/.zarray");
+        std::string metadata((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        size_t entries = std::distance(std::filesystem::directory_iterator(store + "/" + name),
+                                       std::filesystem::directory_iterator());
+        if (ok && (metadata.find("\"shape\": [0, ") == std::string::npos || entries != 2)) {
+            std::cerr << "[check] zarr_store: zero-extent array " << name << " not stored as metadata only" << std::endl;
+            ok = false;
+        }
+    }
+    if (ok && (std::memcmp(profile_read.data(), profile.data(), profile.size() * sizeof(double)) != 0 ||
+               flags_read != flags || sweep_read != sweep ||
+               parameters_read != std::vector<double>({1, 2, 3, 4, 5, 6}))) {
+        std::cerr << "[check] zarr_store: values differ" << std::endl;
+        ok = false;
+    }
+
+    // A store is replaced, any other non-empty directory is refused
+    try {
+        Zarr_Writer replaced(store);
+        std::ofstream(store + "/unrelated.txt") << "x";
+        std::filesystem::remove(store + "/.zgroup");
+        Zarr_Writer refused(store);
+        std::cerr << "[check] zarr_store: non-store directory was overwritten" << std::endl;
+        ok = false;
+    } catch (const std::runtime_error&) {
+    }
+    std::filesystem::remove_all(store);
+    return ok;
+}
+
+} // namespace
+
+std::vector<NamedCheck> zarrChecks() {
+    return {
+        {"zarr_store", [] { return checkZarrStore(); }},
+    };
+}
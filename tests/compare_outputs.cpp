@@ -0,0 +1,50 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <highfive/H5File.hpp>
+
+// Compares every top-level dataset of two output files byte for byte.
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <Output_A> <Output_B>" << std::endl;
+        return 1;
+    }
+    try {
+        HighFive::File a(argv[1], HighFive::File::ReadOnly);
+        HighFive::File b(argv[2], HighFive::File::ReadOnly);
+        std::vector<std::string> names = a.listObjectNames();
+        if (names != b.listObjectNames()) {
+            std::cerr << "[compare_outputs] Files hold different datasets" << std::endl;
+            return 1;
+        }
+
+        size_t differences = 0;
+        for (const auto& name : names) {
+            HighFive::DataSet da = a.getDataSet(name);
+            HighFive::DataSet db = b.getDataSet(name);
+            HighFive::DataType type = da.getDataType();
+            if (da.getDimensions() != db.getDimensions() || !(type == db.getDataType())) {
+                std::cerr << "[compare_outputs] " << name << ": shape or type differs" << std::endl;
+                ++differences;
+                continue;
+            }
+            size_t bytes = da.getElementCount() * type.getSize();
+            std::vector<char> va(bytes), vb(bytes);
+            if (bytes > 0) {
+                da.read_raw(va.data(), type);
+                db.read_raw(vb.data(), type);
+            }
+            if (va != vb) {
+                std::cerr << "[compare_outputs] " << name << ": values differ" << std::endl;
+                ++differences;
+            }
+        }
+        std::cout << "[compare_outputs] " << names.size() << " datasets, " << differences << " different" << std::endl;
+        return differences == 0 ? 0 : 1;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "[compare_outputs] Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,419 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <memory>
+#include "CheckSupport.hpp"
+
+// Golden-output equivalence and throughput regression check.
+//
+// Every case runs a synthetic frame through CloudConstructor and compares
+// mapped_indices / mapped_data against the stored golden output, either
+// bit-for-bit or, for approximate modes, within the declared index agreement.
+// Throughput cases are timed and compared against a per-host baseline file.
+// The feature equivalence checks live in their own sources (*Check.cpp) and
+// share the batch reference and comparisons of CheckSupport.
+
+namespace {
+
+struct RegressionCase {
+    SceneSpec scene;
+    size_t k_candidates;
+    size_t max_idx_distance;
+    size_t i_min, i_max;             // Processing rows (inclusive)
+    // 1.0: bit-for-bit. Otherwise the declared tolerance of an approximate mode: the
+    // fraction of pixels whose donor spectrum is at most the multiresolution
+    // spectral threshold farther than the golden donor's
+    double min_agreement = 1.0;
+    size_t multires_block = 0;        // > 0: multiresolution mode with this block size
+    std::string golden;               // Golden output to compare against (default: own name)
+};
+
+struct PerfCase {
+    SceneSpec scene;
+    size_t k_candidates;
+    size_t max_idx_distance;
+    size_t repeats;
+    size_t multires_block = 0;        // > 0: multiresolution mode, which must beat construct()
+};
+
+struct RunResult {
+    size_t H_out = 0, W_out = 0, K = 0, L = 0;
+    std::vector<size_t> mapped_indices;
+    uint64_t data_hash = 0;
+    double seconds = 0.0;
+    double searched_fraction = 1.0;
+    std::shared_ptr<SyntheticScene> scene; // Holds the AC_CLP log spectra of the run
+};
+
+std::vector<RegressionCase> regressionCases() {
+    return {
+        // name, H, W, K, aux_offset, seed
+        {{"small",    48, 16, 6, 100, 11}, 20, 12,  0, 47, 1.0, 0, ""},
+        {{"window",   64, 20, 4, 100, 23}, 50,  8, 10, 49, 1.0, 0, ""},
+        {{"sparse_k", 40, 12, 5, 100, 37},  3,  4,  0, 39, 1.0, 0, ""},
+        {{"wide_idx", 56, 14, 3, 100, 41}, 56, 60,  5, 50, 1.0, 0, ""},
+        // Flat cloud decks, spatially coherent donors
+        {{"decks",       64, 24, 6, 100, 11, 0.0,  3}, 64, 100, 0, 63, 1.0, 0, ""},
+        {{"decks_noisy", 64, 24, 6, 100, 11, 0.01, 3}, 64, 100, 0, 63, 1.0, 0, ""},
+        // Approximate modes, compared against the exact golden output
+        {{"multires_decks", 64, 24, 6, 100, 11, 0.0,  3}, 64, 100, 0, 63, 0.99, 8, "decks"},
+        {{"multires_noisy", 64, 24, 6, 100, 11, 0.01, 3}, 64, 100, 0, 63, 0.99, 4, "decks_noisy"},
+    };
+}
+
+std::vector<PerfCase> perfCases() {
+    return {
+        {{"perf_standard", 600, 64, 10, 100, 101}, 100, 200, 3},
+        {{"perf_deep_k",   300, 48, 10, 100, 103}, 300, 400, 3},
+        {{"perf_multires", 600, 64, 10, 100, 101, 0.01, 3}, 100, 200, 3, 8},
+    };
+}
+
+uint64_t fnv1a(uint64_t hash, const void* data, size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t n = 0; n < size; ++n) {
+        hash ^= bytes[n];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+// Hash of mapped_data in canonical (i, j, k, l) order, independent of storage layout
+uint64_t hashMappedData(const CloudConstructor& constructor, size_t H_out, size_t W_out) {
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    const auto& data = constructor.getMappedData();
+    for (size_t i = 0; i < H_out; ++i) {
+        for (size_t j = 0; j < W_out; ++j) {
+            for (size_t k = 0; k < constructor.verticalLevels(); ++k) {
+                for (size_t l = 0; l < constructor.numVariables(); ++l) {
+                    double value = data[constructor.flatIndex(i, j, k, l)];
+                    uint64_t bits;
+                    std::memcpy(&bits, &value, sizeof(bits));
+                    hash = fnv1a(hash, &bits, sizeof(bits));
+                }
+            }
+        }
+    }
+    return hash;
+}
+
+RunResult runConstructor(const SceneSpec& spec, size_t k_candidates, size_t max_idx_distance,
+                         size_t i_min, size_t i_max, size_t repeats, size_t multires_block = 0) {
+    auto scene_ptr = std::make_shared<SyntheticScene>(makeSyntheticScene(spec));
+    const SyntheticScene& scene = *scene_ptr;
+    RunResult result;
+    result.scene = scene_ptr;
+    result.H_out = i_max - i_min + 1;
+    result.W_out = spec.W;
+    result.K = spec.K;
+    result.L = kNumVariables;
+
+    CoutSilencer silencer;
+    CloudConstructor constructor(scene.msi.get(), scene.acclp.get(), scene.aux2d.get(),
+                                 k_candidates, max_idx_distance, spec.K, kNumVariables,
+                                 i_min, i_max, 0, spec.W - 1);
+
+    double best = 0.0;
+    for (size_t r = 0; r < std::max<size_t>(repeats, 1); ++r) {
+        auto start = std::chrono::steady_clock::now();
+        if (multires_block > 0) {
+            CloudConstructor::MultiresolutionOptions options;
+            options.block_size = multires_block;
+            result.searched_fraction = constructor.constructMultiresolution(options).searched_fraction;
+        } else {
+            constructor.construct();
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = (r == 0) ? elapsed.count() : std::min(best, elapsed.count());
+    }
+    result.seconds = best;
+    result.mapped_indices.assign(constructor.getMappedIndices().begin(), constructor.getMappedIndices().end());
+    result.data_hash = hashMappedData(constructor, result.H_out, result.W_out);
+    return result;
+}
+
+// Checks that compare a mode or backend against a reference run instead of a golden file
+std::vector<NamedCheck> equivalenceChecks() {
+    std::vector<NamedCheck> checks;
+    for (auto table : {sweepChecks, incrementalChecks, inputChecks, searchOptionsChecks, zarrChecks, libraryChecks}) {
+        for (auto& check : table()) checks.push_back(std::move(check));
+    }
+    return checks;
+}
+
+std::string goldenPath(const std::string& dir, const std::string& name) {
+    return dir + "/" + name + ".golden";
+}
+
+void writeGolden(const std::string& path, const std::string& name, const RunResult& result) {
+    std::ofstream out(path);
+    if (!out) {
+        throw std::runtime_error("Cannot write golden file: " + path);
+    }
+    out << "# barker-pixel-matching golden output v1\n";
+    out << "case " << name << "\n";
+    out << "shape " << result.H_out << " " << result.W_out << " " << result.K << " " << result.L << "\n";
+    out << "mapped_data_fnv1a " << std::hex << result.data_hash << std::dec << "\n";
+    out << "mapped_indices\n";
+    for (size_t i = 0; i < result.H_out; ++i) {
+        for (size_t j = 0; j < result.W_out; ++j) {
+            out << (j ? " " : "") << result.mapped_indices[i * result.W_out + j];
+        }
+        out << "\n";
+    }
+}
+
+bool readGolden(const std::string& path, RunResult& golden) {
+    std::ifstream in(path);
+    if (!in) {
+        return false;
+    }
+    std::string line, key;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream fields(line);
+        fields >> key;
+        if (key == "shape") {
+            fields >> golden.H_out >> golden.W_out >> golden.K >> golden.L;
+        } else if (key == "mapped_data_fnv1a") {
+            fields >> std::hex >> golden.data_hash;
+        } else if (key == "mapped_indices") {
+            golden.mapped_indices.resize(golden.H_out * golden.W_out);
+            for (auto& index : golden.mapped_indices) {
+                in >> index;
+            }
+            return static_cast<bool>(in);
+        }
+    }
+    return false;
+}
+
+bool compareWithGolden(const RegressionCase& c, const RunResult& result, const RunResult& golden) {
+    const std::string& name = c.scene.name;
+    if (result.H_out != golden.H_out || result.W_out != golden.W_out ||
+        result.K != golden.K || result.L != golden.L) {
+        std::cerr << "[check] " << name << ": shape mismatch" << std::endl;
+        return false;
+    }
+
+    size_t first_diff = std::mismatch(result.mapped_indices.begin(), result.mapped_indices.end(),
+                                      golden.mapped_indices.begin()).first - result.mapped_indices.begin();
+    if (c.min_agreement >= 1.0) {
+        if (first_diff != result.mapped_indices.size()) {
+            std::cerr << "[check] " << name << ": mapped_indices differ at pixel ("
+                      << first_diff / result.W_out << "," << first_diff % result.W_out << "): "
+                      << result.mapped_indices[first_diff] << " != golden "
+                      << golden.mapped_indices[first_diff] << std::endl;
+            return false;
+        }
+        if (result.data_hash != golden.data_hash) {
+            std::cerr << "[check] " << name << ": mapped_data hash " << std::hex << result.data_hash
+                      << " != golden " << golden.data_hash << std::dec << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Approximate modes may pick another, spectrally equivalent donor
+    const double threshold = CloudConstructor::MultiresolutionOptions().spectral_threshold;
+    const SyntheticScene& scene = *result.scene;
+    auto distance = [&](size_t pixel, size_t ac_idx) {
+        double sum = 0.0;
+        for (size_t b = 0; b < scene.msi->bands(); ++b) {
+            double diff = std::log(scene.msi->radianceAt(pixel / result.W_out + c.i_min, pixel % result.W_out, b)) -
+                          scene.acclp->radiance[ac_idx][b];
+            sum += diff * diff;
+        }
+        return std::sqrt(sum);
+    };
+    size_t same_index = 0;
+    size_t equivalent = 0;
+    for (size_t n = 0; n < result.mapped_indices.size(); ++n) {
+        if (result.mapped_indices[n] == golden.mapped_indices[n]) {
+            ++same_index;
+            ++equivalent;
+        } else if (distance(n, result.mapped_indices[n]) - distance(n, golden.mapped_indices[n]) <= threshold) {
+            ++equivalent;
+        }
+    }
+    double num_pixels = std::max<double>(result.mapped_indices.size(), 1.0);
+    double agreement = equivalent / num_pixels;
+    if (agreement < c.min_agreement) {
+        std::cerr << "[check] " << name << ": spectral agreement " << agreement
+                  << " below declared tolerance " << c.min_agreement << std::endl;
+        return false;
+    }
+    std::cout << "[check] " << name << ": spectral agreement " << agreement << ", index agreement "
+              << same_index / num_pixels << ", searched fraction " << result.searched_fraction << std::endl;
+    return true;
+}
+
+std::map<std::string, double> readPerfBaseline(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        throw std::runtime_error("Missing throughput baseline " + path + " (run `make perf-baseline` first)");
+    }
+    std::map<std::string, double> baseline;
+    std::string name;
+    double pixels_per_second;
+    while (in >> name >> pixels_per_second) {
+        baseline[name] = pixels_per_second;
+    }
+    if (baseline.empty()) {
+        throw std::runtime_error("Empty throughput baseline " + path + " (run `make perf-baseline` first)");
+    }
+    return baseline;
+}
+
+void usage(const char* argv0) {
+    std::cerr << "Usage: " << argv0 << " [--golden-dir DIR] [--update-golden]"
+              << " [--perf-baseline FILE] [--perf-threshold FRACTION] [--record-baseline] [--no-perf]"
+              << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string golden_dir = "tests/golden";
+    std::string perf_baseline_path;
+    double perf_threshold = 0.25;
+    bool update_golden = false;
+    bool record_baseline = false;
+    bool run_perf = true;
+
+    for (int a = 1; a < argc; ++a) {
+        std::string arg = argv[a];
+        if (arg == "--golden-dir" && a + 1 < argc) {
+            golden_dir = argv[++a];
+        } else if (arg == "--update-golden") {
+            update_golden = true;
+        } else if (arg == "--perf-baseline" && a + 1 < argc) {
+            perf_baseline_path = argv[++a];
+        } else if (arg == "--perf-threshold" && a + 1 < argc) {
+            perf_threshold = std::stod(argv[++a]);
+        } else if (arg == "--record-baseline") {
+            record_baseline = true;
+        } else if (arg == "--no-perf") {
+            run_perf = false;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    size_t failures = 0;
+    try {
+        // Golden-output equivalence //
+        for (const auto& c : regressionCases()) {
+            RunResult result = runConstructor(c.scene, c.k_candidates, c.max_idx_distance,
+                                              c.i_min, c.i_max, 1, c.multires_block);
+            std::string path = goldenPath(golden_dir, c.golden.empty() ? c.scene.name : c.golden);
+            if (update_golden) {
+                if (!c.golden.empty()) continue;
+                writeGolden(path, c.scene.name, result);
+                std::cout << "[check] " << c.scene.name << ": golden updated (" << path << ")" << std::endl;
+                continue;
+            }
+
+            RunResult golden;
+            if (!readGolden(path, golden)) {
+                std::cerr << "[check] " << c.scene.name << ": missing or unreadable golden " << path << std::endl;
+                ++failures;
+                continue;
+            }
+            bool ok = compareWithGolden(c, result, golden);
+            std::cout << "[check] " << c.scene.name << ": " << (ok ? "OK" : "FAILED") << std::endl;
+            failures += ok ? 0 : 1;
+        }
+
+        // Equivalence checks of the other modes and backends //
+        if (!update_golden) {
+            for (const auto& check : equivalenceChecks()) {
+                bool ok = check.run();
+                std::cout << "[check] " << check.name << ": " << (ok ? "OK" : "FAILED") << std::endl;
+                failures += ok ? 0 : 1;
+            }
+        }
+
+        // Throughput regression //
+        if (run_perf) {
+            std::map<std::string, double> baseline;
+            if (!perf_baseline_path.empty() && !record_baseline) {
+                baseline = readPerfBaseline(perf_baseline_path);
+            }
+            std::ofstream record;
+            if (record_baseline) {
+                if (perf_baseline_path.empty()) {
+                    throw std::runtime_error("--record-baseline requires --perf-baseline FILE");
+                }
+                record.open(perf_baseline_path);
+            }
+
+            for (const auto& p : perfCases()) {
+                RunResult result = runConstructor(p.scene, p.k_candidates, p.max_idx_distance,
+                                                  0, p.scene.H - 1, p.repeats, p.multires_block);
+                double pixels_per_second = (result.H_out * result.W_out) / result.seconds;
+                std::cout << "[perf] " << p.scene.name << ": " << std::fixed << std::setprecision(0)
+                          << pixels_per_second << " pixels/s" << std::defaultfloat;
+                if (p.multires_block > 0) {
+                    // Same host, same run: the coarse-to-fine search must be faster than the full one
+                    RunResult full = runConstructor(p.scene, p.k_candidates, p.max_idx_distance,
+                                                    0, p.scene.H - 1, p.repeats);
+                    double speedup = full.seconds / result.seconds;
+                    std::cout << ", " << std::setprecision(3) << speedup << "x construct(), searched fraction "
+                              << result.searched_fraction;
+                    if (speedup <= 1.0) {
+                        std::cout << std::endl;
+                        std::cerr << "[check] " << p.scene.name << ": multiresolution is not faster than construct()"
+                                  << std::endl;
+                        ++failures;
+                        continue;
+                    }
+                }
+
+                if (record_baseline) {
+                    record << p.scene.name << " " << pixels_per_second << "\n";
+                    std::cout << " (recorded)" << std::endl;
+                    continue;
+                }
+                if (perf_baseline_path.empty()) {
+                    std::cout << " (not compared, no --perf-baseline)" << std::endl;
+                    continue;
+                }
+                auto it = baseline.find(p.scene.name);
+                if (it == baseline.end()) {
+                    std::cout << std::endl;
+                    std::cerr << "[check] " << p.scene.name << ": no entry in " << perf_baseline_path
+                              << " (run `make perf-baseline` again)" << std::endl;
+                    ++failures;
+                    continue;
+                }
+                double ratio = pixels_per_second / it->second;
+                bool ok = ratio >= 1.0 - perf_threshold;
+                std::cout << ", " << std::setprecision(3) << ratio << "x baseline"
+                          << (ok ? "" : " -- REGRESSION") << std::endl;
+                failures += ok ? 0 : 1;
+            }
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "[check] Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    if (failures) {
+        std::cerr << "[check] " << failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "[check] All checks passed" << std::endl;
+    return 0;
+}
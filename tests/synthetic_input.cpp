@@ -0,0 +1,33 @@
+#include <iostream>
+#include <string>
+#include "SyntheticScene.hpp"
+
+// Writes a synthetic MSI_RGR / AC_CLP / AUX_2D frame as product files,
+// e.g. as input of the multi-process check.
+int main(int argc, char** argv) {
+    if (argc < 4) {
+        std::cerr << "Usage: " << argv[0] << " <MSI_RGR_File> <AC_CLP_File> <AUX_2D_File> [H] [W] [K] [Seed]" << std::endl;
+        return 1;
+    }
+    try {
+        SceneSpec spec;
+        spec.name = "synthetic_input";
+        spec.H = 256;
+        spec.W = 24;
+        spec.K = 8;
+        spec.seed = 83;
+        if (argc > 4) spec.H = std::stoul(argv[4]);
+        if (argc > 5) spec.W = std::stoul(argv[5]);
+        if (argc > 6) spec.K = std::stoul(argv[6]);
+        if (argc > 7) spec.seed = std::stoull(argv[7]);
+
+        writeSyntheticScene(makeSyntheticScene(spec), argv[1], argv[2], argv[3]);
+        std::cout << "[synthetic_input] Wrote " << spec.H << " x " << spec.W << " frame, "
+                  << spec.K << " levels" << std::endl;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "[synthetic_input] Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}